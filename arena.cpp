@@ -0,0 +1,140 @@
+#include "arena.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <new>
+
+using namespace std;
+
+namespace util {
+//
+// Size of x86-64 huge pages on Linux and the first block of an arena
+//
+static constexpr size_t kHugePageSize{2 * 1024 * 1024};
+
+//
+//
+//
+static atomic<bool> huge_pages_enabled{false};
+
+//
+//
+//
+static size_t GetPageSize() noexcept {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+//
+//
+//
+static size_t GetHugePageSize() noexcept {
+#ifdef _WIN32
+  const size_t page_size{GetLargePageMinimum()};
+  return page_size != 0 ? page_size : kHugePageSize;
+#else
+  return kHugePageSize;
+#endif
+}
+
+//
+//
+//
+size_t PageResource::GetMappingSize(size_t bytes) const noexcept {
+  static const size_t page_size{GetPageSize()};
+  static const size_t huge_page_size{GetHugePageSize()};
+
+  const size_t granularity{m_huge_pages ? huge_page_size : page_size};
+  return (bytes + granularity - 1) / granularity * granularity;
+}
+
+//
+// Pages are aligned more than any type. Explicit huge pages need to be
+// reserved by the administrator, so regular pages are the fallback
+//
+void* PageResource::do_allocate(size_t bytes, size_t /*alignment*/) {
+  const size_t mapping_size{GetMappingSize(bytes)};
+
+#ifdef _WIN32
+  if (m_huge_pages) {
+    // Needs SeLockMemoryPrivilege
+    if (void* ptr = VirtualAlloc(nullptr, mapping_size,
+                                 MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                 PAGE_READWRITE)) {
+      return ptr;
+    }
+  }
+
+  void* const ptr{VirtualAlloc(nullptr, mapping_size, MEM_RESERVE | MEM_COMMIT,
+                               PAGE_READWRITE)};
+  if (!ptr) {
+    throw bad_alloc{};
+  }
+  return ptr;
+#else
+#ifdef MAP_HUGETLB
+  if (m_huge_pages) {
+    if (void* ptr = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        ptr != MAP_FAILED) {
+      return ptr;
+    }
+  }
+#endif
+
+  void* const ptr{mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+  if (ptr == MAP_FAILED) {
+    throw bad_alloc{};
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (m_huge_pages) {
+    madvise(ptr, mapping_size, MADV_HUGEPAGE);  // Transparent huge pages
+  }
+#endif
+  return ptr;
+#endif
+}
+
+//
+//
+//
+void PageResource::do_deallocate(void* ptr,
+                                 size_t bytes,
+                                 size_t /*alignment*/) {
+#ifdef _WIN32
+  (void)bytes;
+  VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+  munmap(ptr, GetMappingSize(bytes));
+#endif
+}
+
+//
+//
+//
+Arena::Arena()
+    : m_pages{huge_pages_enabled.load(memory_order_relaxed)},
+      m_resource{kHugePageSize, &m_pages} {}
+
+//
+//
+//
+void Arena::EnableHugePages(bool enabled) noexcept {
+  huge_pages_enabled.store(enabled, memory_order_relaxed);
+}
+}  // namespace util
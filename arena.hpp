@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+
+namespace util {
+//
+// Whole pages requested from the OS; huge pages are used if they are
+// enabled and the OS provides them
+//
+class PageResource : public std::pmr::memory_resource {
+ public:
+  explicit PageResource(bool huge_pages) noexcept : m_huge_pages{huge_pages} {}
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  size_t GetMappingSize(size_t bytes) const noexcept;
+
+ private:
+  bool m_huge_pages;
+};
+
+//
+// Monotonic memory of a single thread: allocation is a pointer bump, and
+// all memory is released at once by the destructor
+//
+class Arena {
+ public:
+  Arena();
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  std::pmr::memory_resource* GetResource() noexcept { return &m_resource; }
+
+  //
+  // Arenas created after the call are backed by huge pages
+  //
+  static void EnableHugePages(bool enabled) noexcept;
+
+ private:
+  PageResource m_pages;
+  std::pmr::monotonic_buffer_resource m_resource;
+};
+}  // namespace util
@@ -1,14 +1,18 @@
 ﻿#include "backblaze.hpp"
+#include "buffer_pool.hpp"
+#include "coroutine.hpp"
+#include "cpu.hpp"
+#include "csv.hpp"
+#include "mapped_file.hpp"
 
-#include <rapidcsv.h>
 #include <spdlog/stopwatch.h>
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/split.hpp>
 #include "unordered_dense/include/ankerl/unordered_dense.h"
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <fstream>
+#include <span>
 #include <stdexcept>
 #include <variant>
 
@@ -18,12 +22,66 @@ int main(int argc, char* argv[]) {
   try {
     spdlog::set_pattern("[%T.%e] [T%t] [%^%l%$] %v");
 
-    if (argc != 3) {
-      throw invalid_argument{"Usage: <input-path> <output-path>"};
+    constexpr string_view kUsage{
+        "Usage: [--from YYYY-MM] [--to YYYY-MM] [--huge-pages] "
+        "[--largest-first] [--sharded] [--by-date] [-j N] [--pin] "
+        "[--io-threads N] <input-path> <output-path>"};
+
+    bb::ParseOptions options;
+    auto& months{options.months};
+    size_t thread_count{0};  // Available CPUs
+    bool pin_threads{false};
+    vector<string_view> paths;
+    for (int idx = 1; idx < argc; ++idx) {
+      if (const string_view arg{argv[idx]}; arg == "--from" || arg == "--to") {
+        if (++idx == argc) {
+          throw invalid_argument{string{kUsage}};
+        }
+        (arg == "--from" ? months.first : months.last) =
+            bb::ParseMonth(argv[idx]);
+      } else if (arg == "-j") {
+        if (++idx == argc) {
+          throw invalid_argument{string{kUsage}};
+        }
+        thread_count = util::ToInt<size_t>(argv[idx]);
+        if (thread_count == 0) {
+          throw invalid_argument{"Number of threads must be positive"};
+        }
+      } else if (arg == "--io-threads") {
+        if (++idx == argc) {
+          throw invalid_argument{string{kUsage}};
+        }
+        options.io_threads = util::ToInt<size_t>(argv[idx]);
+      } else if (arg == "--pin") {
+        pin_threads = true;
+      } else if (arg == "--huge-pages") {
+        util::Arena::EnableHugePages(true);
+      } else if (arg == "--largest-first") {
+        options.largest_first = true;
+      } else if (arg == "--sharded") {
+        options.sharded = true;
+      } else if (arg == "--by-date") {
+        options.by_date = true;
+      } else {
+        paths.push_back(arg);
+      }
+    }
+
+    if (size(paths) != 2) {
+      throw invalid_argument{string{kUsage}};
+    }
+
+    if (months.first > months.last) {
+      throw invalid_argument{"Empty range of months"};
+    }
+
+    if (options.by_date && (options.largest_first || options.sharded)) {
+      throw invalid_argument{
+          "--by-date isn't combined with --largest-first and --sharded"};
     }
 
-    const filesystem::path input{argv[1]};
-    const filesystem::path output{argv[2]};
+    const filesystem::path input{paths[0]};
+    const filesystem::path output{paths[1]};
 
     if (output.extension() != ".csv") {
       throw invalid_argument{"Only CSV output is supported"};
@@ -31,20 +89,51 @@ int main(int argc, char* argv[]) {
 
     spdlog::info("Input: {}", input.string());
     spdlog::info("Output: {}", output.string());
+    spdlog::info("CSV scanner: {}", csv::GetScannerName());
+
+    if (thread_count == 0) {
+      thread_count = util::GetAvailableCpuCount();
+    }
+    // Shards are used for directories and archives only
+    const bool sharded{options.sharded &&
+                       (is_directory(input) || input.extension() == ".zip")};
+    const size_t shard_count{
+        sharded ? bb::ShardedStats::GetShardCount(thread_count) : 0};
+    spdlog::info("Threads: {}{}", thread_count,
+                 pin_threads ? ", pinned" : "");
+    if (options.io_threads != 0) {
+      spdlog::info("I/O threads: {}", options.io_threads);
+    }
+    util::ThreadPool pool{max<size_t>(thread_count - shard_count, 1),
+                          pin_threads};
 
     const spdlog::stopwatch timer;
-    const bb::DataCenterStats model_map{[&input] {
-      if (is_directory(input)) {
-        return ParseRawStats(filesystem::recursive_directory_iterator{input});
+    const auto parse_and_write{[&output, &options, &pool, &timer,
+                                shard_count](auto first, auto last) {
+      if (options.sharded) {
+        const auto sharded_stats{
+            ParseShardedRawStats(first, last, options, pool, shard_count)};
+        info("Finished: {:.3} seconds", timer);
+        WriteParsedStats(sharded_stats->GetShards(), output, pool);
+      } else {
+        const auto dc_stats{ParseRawStats(first, last, options, pool)};
+        info("Finished: {:.3} seconds", timer);
+        WriteParsedStats(dc_stats, output, pool);
       }
-
-      bb::DataCenterStats map;
-      ReadRawStats(map, input);
-      return map;
-    }()};
-
-    info("Finished: {:.3} seconds", timer);
-    WriteParsedStats(model_map, output);
+    }};
+
+    if (is_directory(input)) {
+      parse_and_write(filesystem::recursive_directory_iterator{input},
+                      filesystem::recursive_directory_iterator{});
+    } else if (input.extension() == ".zip") {
+      const array entries{filesystem::directory_entry{input}};
+      parse_and_write(begin(entries), end(entries));
+    } else {
+      bb::DataCenterStats dc_stats{make_shared<bb::DriveDictionary>()};
+      ReadRawStats(dc_stats, input, months, &pool);
+      info("Finished: {:.3} seconds", timer);
+      WriteParsedStats(dc_stats, output, pool);
+    }
 
   } catch (...) {
     util::PrintException(current_exception());
@@ -89,58 +178,313 @@ void PrintException(const exception_ptr& exc_ptr) noexcept {
 
 namespace bb {
 //
+// Columns of raw stats used by ReadRawStats; the rest are skipped
+//
+enum RawColumn : size_t {
+  kDateColumn,
+  kSerialNumberColumn,
+  kModelColumn,
+  kCapacityColumn,
+  kFailureColumn,
+  kPowerOnHourColumn,
+};
+
+static constexpr array<string_view, 6> kRawColumns{
+    "date", "serial_number", "model", "capacity_bytes", "failure",
+    "smart_9_raw"};
+
+//
+// Smaller files aren't worth splitting between threads
+//
+static constexpr size_t kMinChunkSize{16 * 1024 * 1024};
+
+//
+// Drives merged by a single task of MergeParsedStats; a multiple of the
+// cache line size, so tasks don't share lines of DriveDayMatrix rows
+//
+static constexpr size_t kMergeRangeSize{64 * 1024};
+
+//
+// Drives formatted by a single task of WriteParsedStats
+//
+static constexpr size_t kWriteRangeSize{16 * 1024};
+
+//
+// Records passed to a RecordSink at once
+//
+static constexpr size_t kRecordBatchSize{1024};
+
+//
+// Streams and files are parsed by blocks of complete records of about this
+// size; a block grows only if a single record doesn't fit into it
+//
+static constexpr size_t kStreamBufferSize{4 * 1024 * 1024};
+
+//
+// Mapped data of a source which is read into memory by a fetcher at most,
+// so it isn't evicted before it's used
 //
+static constexpr size_t kMaxPrefetchSize{256 * 1024 * 1024};
+
+//
+// "YYYY-MM-DD"
+//
+static constexpr size_t kFixedDateLength{10};
+
 //
-static Date ReadDate(const rapidcsv::Document& doc, size_t row_idx) {
-  vector<string> yy_mm_dd;
-  yy_mm_dd.reserve(kDateLength);
+// Decodes "YYYY-MM-DD"; the calendar date isn't validated
+//
+static optional<Date> DecodeFixedDate(string_view str) noexcept {
+  constexpr array<uint8_t, 8> kDigitOffsets{0, 1, 2, 3, 5, 6, 8, 9};
 
-  split(yy_mm_dd, doc.GetCell<string>("date", row_idx), boost::is_any_of("-"));
-  if (size(yy_mm_dd) != kDateLength) {
-    throw invalid_argument{"Invalid date format"};
+  if (size(str) != kFixedDateLength || str[4] != '-' || str[7] != '-') {
+    return nullopt;
   }
 
-  do {
-    const auto year{util::ToInt<uint16_t>(yy_mm_dd[0])};
-    if (year < kFirstYear || year > kLastYear) {
-      break;
+  array<unsigned int, size(kDigitOffsets)> digits;
+  bool valid{true};
+  for (size_t idx = 0; idx < size(kDigitOffsets); ++idx) {
+    digits[idx] = static_cast<unsigned char>(str[kDigitOffsets[idx]]) - '0';
+    valid &= digits[idx] < 10;
+  }
+
+  if (!valid) {
+    return nullopt;
+  }
+
+  const auto year{digits[0] * 1000 + digits[1] * 100 + digits[2] * 10 +
+                  digits[3]};
+  const auto month{digits[4] * 10 + digits[5]};
+  const auto day{digits[6] * 10 + digits[7]};
+
+  return Date{chrono::year{static_cast<int>(year)}, chrono::month{month},
+              chrono::day{day}};
+}
+
+//
+// Date of a record in forms used by stats
+//
+struct RecordDate {
+  DayNumber day;
+  MonthIdx month_idx;
+};
+
+//
+//
+//
+static MonthIdx MakeMonthIndex(unsigned int year, unsigned int month) noexcept {
+  return static_cast<MonthIdx>(year * kMonthPerYear + month - 1);
+}
+
+//
+// Row of the date's month in DriveDayMatrix; years of valid dates aren't
+// negative
+//
+static MonthIdx GetMonthIndex(const Date& date) noexcept {
+  return MakeMonthIndex(static_cast<unsigned int>(int{date.year()}),
+                        static_cast<unsigned int>(date.month()));
+}
+
+//
+//
+//
+static Date GetDate(DayNumber day) noexcept {
+  return Date{kEpoch + chrono::days{day}};
+}
+
+//
+// Falls back to "Y-M-D" with unpadded components
+//
+static RecordDate ParseDate(string_view str) {
+  auto date{DecodeFixedDate(str)};
+  if (!date) {
+    const size_t month_offset{str.find('-') + 1};
+    const size_t day_offset{str.find('-', month_offset) + 1};
+    if (month_offset == 0 || day_offset == 0 ||
+        str.find('-', day_offset) != string_view::npos) {
+      throw invalid_argument{"Invalid date format"};
     }
 
-    const auto month{util::ToInt<uint8_t>(yy_mm_dd[1])};
-    const auto day{util::ToInt<uint8_t>(yy_mm_dd[2])};
+    const auto year{util::ToInt<uint16_t>(str.substr(0, month_offset - 1))};
+    const auto month{util::ToInt<uint8_t>(
+        str.substr(month_offset, day_offset - month_offset - 1))};
+    const auto day{util::ToInt<uint8_t>(str.substr(day_offset))};
 
-    const Date date{chrono::year{year}, chrono::month{month}, chrono::day{day}};
-    if (!date.ok()) {
-      break;
+    date = Date{chrono::year{year}, chrono::month{month}, chrono::day{day}};
+  }
+
+  const auto day{date->ok() ? (chrono::sys_days{*date} - kEpoch).count() : -1};
+  if (day < 0 || day > numeric_limits<DayNumber>::max()) {
+    throw invalid_argument{fmt::format("Invalid date {}", str)};
+  }
+
+  return {static_cast<DayNumber>(day), GetMonthIndex(*date)};
+}
+
+//
+// Daily files have a single date, so the date column is decoded once and
+// then only compared with the last raw value. Mixed files are decoded on
+// each change of the value
+//
+class DateReader {
+ public:
+  RecordDate Read(string_view raw_date) {
+    if (m_date && raw_date == GetLastRawDate()) {
+      return *m_date;
+    }
+
+    const RecordDate date{ParseDate(raw_date)};
+    if (size(raw_date) <= size(m_raw_date)) {
+      ranges::copy(raw_date, begin(m_raw_date));
+      m_raw_date_size = size(raw_date);
+      m_date = date;
     }
 
     return date;
+  }
 
-  } while (false);
+ private:
+  string_view GetLastRawDate() const noexcept {
+    return {data(m_raw_date), m_raw_date_size};
+  }
+
+ private:
+  array<char, 16> m_raw_date;
+  size_t m_raw_date_size{0};
+  optional<RecordDate> m_date;
+};
+
+//
+// New rows are empty
+//
+DriveDayMatrix::Row& DriveDayMatrix::GetMonth(MonthIdx month_idx) {
+  if (m_months.empty()) {
+    m_first_month = month_idx;
+    m_months.resize(1);
+  } else if (month_idx < m_first_month) {
+    m_months.insert(begin(m_months), m_first_month - month_idx, {});
+    m_first_month = month_idx;
+  } else if (const size_t offset = month_idx - m_first_month;
+             offset >= size(m_months)) {
+    m_months.resize(offset + 1);
+  }
+  return m_months[month_idx - m_first_month];
+}
+
+//
+// New cells are 0
+//
+void DriveDayMatrix::Extend(MonthIdx month_idx, DriveId drive_id) {
+  if (auto& month = GetMonth(month_idx); drive_id >= size(month)) {
+    month.resize(size_t{drive_id} + 1);
+  }
+}
+
+//
+//
+//
+void DriveDayMatrix::Add(const DriveDayMatrix& other) {
+  Reserve(other);
+  Add(other, 0, numeric_limits<DriveId>::max());
+}
+
+//
+//
+//
+void DriveDayMatrix::Reserve(const DriveDayMatrix& other) {
+  for (size_t offset = 0; offset < size(other.m_months); ++offset) {
+    if (const auto& other_month = other.m_months[offset];
+        !other_month.empty()) {
+      Extend(static_cast<MonthIdx>(other.m_first_month + offset),
+             static_cast<DriveId>(size(other_month) - 1));
+    }
+  }
+}
+
+//
+// Drive ids are the same in both matrices, so rows are added by
+// a vectorized loop
+//
+void DriveDayMatrix::Add(const DriveDayMatrix& other,
+                         DriveId first_id,
+                         DriveId last_id) {
+  for (size_t offset = 0; offset < size(other.m_months); ++offset) {
+    const auto& other_month{other.m_months[offset]};
+    const size_t last{min<size_t>(size(other_month), last_id)};
+    if (first_id >= last) {
+      continue;
+    }
+
+    const auto month_idx{static_cast<MonthIdx>(other.m_first_month + offset)};
+    Value* const month{data(m_months[month_idx - m_first_month])};
+    for (size_t idx = first_id; idx < last; ++idx) {
+      month[idx] += other_month[idx];
+    }
+  }
+}
+
+//
+// Rows between the last row and the other matrix are empty
+//
+void DriveDayMatrix::Splice(const DriveDayMatrix& other) {
+  if (other.m_months.empty()) {
+    return;
+  }
+
+  if (m_months.empty()) {
+    m_first_month = other.m_first_month;
+  } else if (other.m_first_month < m_first_month + size(m_months)) {
+    throw invalid_argument{"Spliced months overlap"};
+  }
 
-  throw invalid_argument{fmt::format("Invalid date {}-{}-{}", yy_mm_dd[0],
-                                     yy_mm_dd[1], yy_mm_dd[2])};
+  m_months.resize(other.m_first_month - m_first_month);
+  m_months.insert(end(m_months), begin(other.m_months), end(other.m_months));
 }
 
 //
 //
 //
-static string ReadId(const rapidcsv::Document& doc,
-                     const string& field,
-                     size_t row_idx) {
-  auto id{doc.GetCell<string>(field, row_idx)};
-  const auto [first, last]{
-      ranges::remove_if(id, [](unsigned char ch) { return isspace(ch); })};
-  id.erase(first, last);
-  return id;
+MonthIdx ParseMonth(string_view str) {
+  const size_t month_offset{str.find('-') + 1};
+  if (month_offset == 0) {
+    throw invalid_argument{fmt::format("Invalid month {}", str)};
+  }
+
+  const auto year{util::ToInt<uint16_t>(str.substr(0, month_offset - 1))};
+  const auto month{util::ToInt<uint8_t>(str.substr(month_offset))};
+  if (month == 0 || month > kMonthPerYear) {
+    throw invalid_argument{fmt::format("Invalid month {}", str)};
+  }
+
+  return MakeMonthIndex(year, month);
+}
+
+//
+// Whitespace is removed from the cell; the buffer is used only if there is
+// any, which is rare
+//
+static string_view ReadId(const csv::Reader& reader,
+                          RawColumn column,
+                          string& buffer) {
+  const auto is_space{[](unsigned char ch) { return isspace(ch) != 0; }};
+
+  const auto id{reader.GetCell(column)};
+  if (ranges::none_of(id, is_space)) {
+    return id;
+  }
+
+  buffer.assign(id);
+  const auto [first, last]{ranges::remove_if(buffer, is_space)};
+  buffer.erase(first, last);
+  return buffer;
 }
 
 //
 //
 //
-static variant<int64_t, uint64_t> ReadCapacity(const rapidcsv::Document& doc,
-                                               size_t row_idx) {
-  const auto raw_capacity{doc.GetCell<int64_t>("capacity_bytes", row_idx)};
+static variant<int64_t, uint64_t> ReadCapacity(const csv::Reader& reader) {
+  const auto raw_capacity{
+      util::ToInt<int64_t>(reader.GetCell(kCapacityColumn))};
   do {
     if (raw_capacity < 0) {
       break;
@@ -161,17 +505,18 @@ static variant<int64_t, uint64_t> ReadCapacity(const rapidcsv::Document& doc,
 //
 //
 //
-static void UpdateCapacity(const ModelName& model_name,
-                           ModelStats& model_stats,
+static void UpdateCapacity(const DriveDictionary& dictionary,
+                           ModelId model_id,
+                           optional<uint64_t>& capacity_bytes,
                            optional<uint64_t> new_capacity) {
-  if (auto& capacity_bytes = model_stats.capacity_bytes;
-      new_capacity > capacity_bytes) {  // new_capacity isn't empty
+  if (new_capacity > capacity_bytes) {  // new_capacity isn't empty
     const auto new_capacity_bytes{
         *new_capacity};  // NOLINT(bugprone-unchecked-optional-access)
 
     if (capacity_bytes) {
-      spdlog::warn("{} capacity change: was {}, now {}", model_name,
-                   *capacity_bytes, new_capacity_bytes);
+      spdlog::warn("{} capacity change: was {}, now {}",
+                   dictionary.GetModelName(model_id), *capacity_bytes,
+                   new_capacity_bytes);
     }
 
     capacity_bytes = new_capacity_bytes;
@@ -181,19 +526,19 @@ static void UpdateCapacity(const ModelName& model_name,
 //
 //
 //
-static void UpdateInitialPowerOnHour(const SerialNumber& serial_number,
-                                     DriveStats& drive_stats,
+static void UpdateInitialPowerOnHour(const DriveDictionary& dictionary,
+                                     DriveId drive_id,
+                                     optional<uint32_t>& initial_power_on_hour,
                                      optional<uint32_t> new_initial_power_on) {
   if (new_initial_power_on) {
     const auto new_initial_power_on_hour{*new_initial_power_on};
-    if (auto& initial_power_on_hour = drive_stats.initial_power_on_hour;
-        !initial_power_on_hour) {
+    if (!initial_power_on_hour) {
       initial_power_on_hour = new_initial_power_on_hour;
     } else if (auto& old_initial_power_on_hour = *initial_power_on_hour;
                old_initial_power_on_hour > new_initial_power_on_hour) {
       spdlog::trace("{} initial power-on hour change: was {}, now {}",
-                    serial_number, old_initial_power_on_hour,
-                    new_initial_power_on_hour);
+                    dictionary.GetSerialNumber(drive_id),
+                    old_initial_power_on_hour, new_initial_power_on_hour);
       old_initial_power_on_hour = new_initial_power_on_hour;
     }
   }
@@ -202,169 +547,1520 @@ static void UpdateInitialPowerOnHour(const SerialNumber& serial_number,
 //
 //
 //
-void ReadRawStats(DataCenterStats& dc_stats,
-                  const filesystem::path& file_path) {
-  ifstream input{file_path, ios::binary};
-  input.exceptions(ios::badbit | ios::failbit);
+void DataCenterStats::AddRecords(span<const RawRecord> records,
+                                 size_t id_divisor) {
+  for (auto run = begin(records); run != end(records);) {
+    const MonthIdx month_idx{run->month_idx};
+    const auto run_end{find_if(next(run), end(records),
+                               [month_idx](const RawRecord& record) {
+                                 return record.month_idx != month_idx;
+                               })};
+
+    UpdateMonthRange({month_idx, month_idx});
+    auto& month{drive_day.GetMonth(month_idx)};
+    for (; run != run_end; ++run) {
+      const size_t drive_idx{id_divisor == 1 ? run->drive_id
+                                             : run->drive_id / id_divisor};
+      AddRecord(*run, static_cast<DriveId>(drive_idx), month);
+    }
+  }
+}
+
+//
+// Names are looked up in the dictionary only if the values change. The
+// drive-day row is the one of the record's month
+//
+void DataCenterStats::AddRecord(const RawRecord& record,
+                                DriveId drive_idx,
+                                DriveDayMatrix::Row& month) {
+  if (record.model_id >= size(model_capacity)) {
+    model_capacity.resize(size_t{record.model_id} + 1);
+  }
+  UpdateCapacity(*dictionary, record.model_id, model_capacity[record.model_id],
+                 record.capacity_bytes);
+
+  if (drive_idx >= GetDriveCount()) {
+    initial_power_on_hour.resize(size_t{drive_idx} + 1);
+    failure_date.resize(size_t{drive_idx} + 1);
+  }
+  UpdateInitialPowerOnHour(*dictionary, record.drive_id,
+                           initial_power_on_hour[drive_idx],
+                           record.initial_power_on_hour);
+
+  if (drive_idx >= size(month)) {
+    month.resize(size_t{drive_idx} + 1);
+  }
+  ++month[drive_idx];
+
+  if (record.failure) {
+    auto& failure_dates{failure_date[drive_idx]};
+    failure_dates.insert(ranges::upper_bound(failure_dates, record.day),
+                         record.day);
+    UpdateMaxFailure(size(failure_dates));
+  }
+}
+
+//
+// Adds records to the stats by drive ids
+//
+class StatsSink : public RecordSink {
+ public:
+  explicit StatsSink(DataCenterStats& dc_stats) noexcept
+      : m_dc_stats{dc_stats} {}
 
-  const rapidcsv::Document doc{input};
-  const size_t row_count{doc.GetRowCount()};
+  void Add(span<const RawRecord> records) override {
+    m_dc_stats.AddRecords(records);
+  }
+
+ private:
+  DataCenterStats& m_dc_stats;
+};
+
+//
+// Turns rows of raw stats into records, which are passed to the sink by
+// batches. Model ids are cached by names, so the dictionary is locked only
+// for new models
+//
+class RecordParser {
+ public:
+  RecordParser(DriveDictionary& dictionary,
+               RecordSink& sink,
+               const MonthRange& months)
+      : m_dictionary{dictionary}, m_sink{sink}, m_months{months} {
+    m_batch.reserve(kRecordBatchSize);
+  }
+
+  //
+  // Records parsed before an error are passed to the sink too
+  //
+  void Parse(csv::Reader& reader) {
+    try {
+      while (reader.ReadRow()) {
+        ParseRow(reader);
+      }
+    } catch (...) {
+      Flush();
+      throw;
+    }
+    Flush();
+  }
+
+ private:
+  //
+  // The date is read first to skip records of months outside of the range
+  //
+  void ParseRow(const csv::Reader& reader) {
+    const auto [day, month_idx]{
+        m_date_reader.Read(reader.GetCell(kDateColumn))};
+    if (!m_months.Contains(month_idx)) {
+      return;
+    }
 
-  for (size_t idx = 0; idx < row_count; ++idx) {
-    const auto model_name{ReadId(doc, "model", idx)};
-    auto& model_stats{dc_stats.models[model_name]};
+    const auto model_name{ReadId(reader, kModelColumn, m_id_buffer)};
+    const auto model_id{GetModelId(model_name)};
 
-    if (const auto capacity = ReadCapacity(doc, idx);
+    optional<uint64_t> capacity_bytes;
+    if (const auto capacity = ReadCapacity(reader);
         holds_alternative<uint64_t>(capacity)) {
-      UpdateCapacity(model_name, model_stats, get<uint64_t>(capacity));
+      capacity_bytes = get<uint64_t>(capacity);
     } else {
       spdlog::warn("{} invalid capacity: {} bytes", model_name,
                    get<int64_t>(capacity));
     }
 
-    const auto serial_number{ReadId(doc, "serial_number", idx)};
-    auto& drive_stats{model_stats.drives[serial_number]};
+    const bool failure{util::ToInt<int>(reader.GetCell(kFailureColumn)) != 0};
+    const auto power_on_hour{reader.GetCell(kPowerOnHourColumn)};
+    const auto initial_power_on_hour{
+        power_on_hour.empty() ? optional<uint32_t>{}
+                              : util::ToInt<uint32_t>(power_on_hour)};
 
-    UpdateInitialPowerOnHour(
-        serial_number, drive_stats, util::Lazy{[&doc, idx] {
-          const auto power_on_hour{doc.GetCell<string>("smart_9_raw", idx)};
-          return power_on_hour.empty() ? optional<uint32_t>{}
-                                       : util::ToInt<uint32_t>(power_on_hour);
-        }});
+    // The model name may be overwritten in the buffer from here. The drive
+    // is added after all cells are parsed, so invalid rows don't add drives
+    // without records
+    const auto drive_id{m_dictionary.AddDrive(
+        model_id, ReadId(reader, kSerialNumberColumn, m_id_buffer))};
 
-    const auto date{ReadDate(doc, idx)};
-    const auto year_idx{static_cast<int>(date.year()) - kFirstYear};
-    const auto month_idx{static_cast<unsigned int>(date.month()) - 1};
-    ++drive_stats.drive_day[static_cast<uint8_t>(year_idx * kMonthPerYear +
-                                                 month_idx)];
+    m_batch.push_back({drive_id, model_id, month_idx, day, failure,
+                       initial_power_on_hour, capacity_bytes});
 
-    if (doc.GetCell<int>("failure", idx) != 0) {
-      auto& failure_date{drive_stats.failure_date};
-      failure_date.insert(ranges::upper_bound(failure_date, date), date);
-      dc_stats.UpdateMaxFailure(size(failure_date));
+    if (size(m_batch) == kRecordBatchSize) {
+      Flush();
     }
   }
-}
+
+  ModelId GetModelId(string_view model_name) {
+    const auto local_id{m_model_names.Intern(model_name)};
+    if (local_id == size(m_model_ids)) {
+      m_model_ids.push_back(m_dictionary.AddModel(model_name));
+    }
+    return m_model_ids[local_id];
+  }
+
+  void Flush() {
+    if (!m_batch.empty()) {
+      m_sink.Add(m_batch);
+      m_batch.clear();
+    }
+  }
+
+ private:
+  DriveDictionary& m_dictionary;
+  RecordSink& m_sink;
+  const MonthRange& m_months;
+
+  DateReader m_date_reader;
+  string m_id_buffer;
+  util::Interner m_model_names;
+  vector<ModelId> m_model_ids;  // By ids of m_model_names
+  vector<RawRecord> m_batch;
+};
 
 //
+// Reads a stream by blocks of complete records. The part of a record at the
+// end of a block is kept for the next one. The prefix is data which was
+// read from the stream before, e.g. to detect its compression
 //
-//
-static vector<string> MakeParsedStatsHeader(const DataCenterStats& dc_stats) {
-  const size_t max_failure{dc_stats.max_failure};
+class RecordStreamReader {
+ public:
+  explicit RecordStreamReader(util::InputStream& stream,
+                              string_view prefix = {})
+      : m_stream{stream}, m_tail{begin(prefix), end(prefix)} {}
+
+  //
+  // Replaces contents of the block; false at the end of the stream. The
+  // last block may be empty
+  //
+  bool Read(vector<char>& block) {
+    if (m_finished) {
+      return false;
+    }
 
-  vector<string> header;
-  header.reserve(size(kOutputPrefix) + max_failure + DriveStats::kCounterCount);
+    block.resize(max(kStreamBufferSize, size(m_tail) * 2));
+    ranges::copy(m_tail, begin(block));
+    size_t block_size{size(m_tail)};
 
-  for (const auto& prefix : kOutputPrefix) {
-    header.emplace_back(prefix);
-  }
+    for (;;) {
+      const size_t read_size{
+          m_stream.Read(span{block}.subspan(block_size))};
+      block_size += read_size;
+      m_finished = read_size == 0;
+
+      if (!m_finished && block_size < size(block)) {
+        continue;
+      }
 
-  for (size_t idx = 0; idx < max_failure; ++idx) {
-    header.push_back(fmt::format("failure_{}", idx + 1));
+      const size_t records_size{
+          m_finished ? block_size
+                     : csv::FindCompleteRecords({data(block), block_size})};
+      if (records_size == 0 && !m_finished) {
+        block.resize(size(block) * 2);
+        continue;
+      }
+
+      m_tail.assign(begin(block) + records_size, begin(block) + block_size);
+      block.resize(records_size);
+      return true;
+    }
   }
 
-  for (auto year = kFirstYear; year <= kLastYear; ++year) {
-    for (uint8_t month = 1; month <= kMonthPerYear; ++month) {
-      header.push_back(fmt::format("date_{}_{}", year, month));
+ private:
+  util::InputStream& m_stream;
+  vector<char> m_tail;
+  bool m_finished{false};
+};
+
+//
+// Columns are found by the header in the first block
+//
+static void ReadRawStream(RecordParser& parser, util::InputStream& stream) {
+  RecordStreamReader stream_reader{stream};
+  vector<char> block;
+  optional<csv::Projection> projection;
+
+  while (stream_reader.Read(block)) {
+    const string_view records{data(block), size(block)};
+    if (!projection) {
+      csv::Reader reader{records, kRawColumns};
+      parser.Parse(reader);
+      projection = reader.GetProjection();
+    } else {
+      csv::Reader reader{records, *projection};
+      parser.Parse(reader);
     }
   }
+}
+
+//
+// Records are split into chunks by a parallel count of quotes
+//
+static vector<string_view> SplitRawRecords(string_view records,
+                                           size_t chunk_count,
+                                           util::ThreadPool& pool) {
+  vector<size_t> quote_counts(chunk_count);
+  util::RunParallel(pool, chunk_count, [&records, &quote_counts](size_t idx) {
+    quote_counts[idx] =
+        csv::CountQuotes(csv::GetEqualPart(records, size(quote_counts), idx));
+  });
 
-  return header;
+  return csv::SplitRecords(records, quote_counts);
 }
 
 //
 //
 //
-static auto MakeParsedStatsRow(const DataCenterStats& dc_stats,
-                               const string& model_name,
-                               const ModelStats& model_stats,
-                               const string& serial_number,
-                               const DriveStats& drive_stats) {
-  const size_t max_failure{dc_stats.max_failure};
+static size_t GetChunkCount(string_view records,
+                            const util::ThreadPool* pool) noexcept {
+  return clamp(size(records) / kMinChunkSize, size_t{1},
+               pool ? pool->GetThreadCount() : size_t{1});
+}
 
-  vector<string> row;
-  row.reserve(size(kOutputPrefix) + dc_stats.max_failure +
-              DriveStats::kCounterCount);
+//
+// Chunks are parsed into stats of their own, which are merged at the end
+//
+void ReadRawStats(DataCenterStats& dc_stats,
+                  const filesystem::path& file_path,
+                  const MonthRange& months,
+                  util::ThreadPool* pool) {
+  StatsSink sink{dc_stats};
+
+  const util::MappedFile file{file_path};
+  if (const auto compression = util::DetectCompression(file.GetView());
+      compression != util::Compression::kNone) {
+    const auto stream{util::MakeDecompressor(file.GetView(), compression)};
+    RecordParser parser{*dc_stats.dictionary, sink, months};
+    ReadRawStream(parser, *stream);
+    return;
+  }
 
-  row.push_back(model_name);
-  row.push_back(serial_number);
-  row.push_back(util::ToString(model_stats.capacity_bytes));
-  row.push_back(util::ToString(drive_stats.initial_power_on_hour));
+  csv::Reader reader{file.GetView(), kRawColumns};
 
-  const auto& failure_date{drive_stats.failure_date};
-  for (const auto& date : failure_date) {
-    row.push_back(util::ToString(date));
+  const auto records{reader.GetUnread()};
+  const size_t chunk_count{GetChunkCount(records, pool)};
+  if (chunk_count == 1) {
+    RecordParser{*dc_stats.dictionary, sink, months}.Parse(reader);
+    return;
   }
 
-  row.insert(end(row), max_failure - size(failure_date), "");
-
-  vector<uint8_t> drive_day(DriveStats::kCounterCount);
-  for (const auto& [idx, value] : drive_stats.drive_day) {
-    drive_day[idx] = value;
+  const vector chunks{SplitRawRecords(records, chunk_count, *pool)};
+  const auto arenas{make_unique<util::Arena[]>(chunk_count)};
+  vector<DataCenterStats> chunk_stats;
+  chunk_stats.reserve(chunk_count);
+  for (size_t idx = 0; idx < chunk_count; ++idx) {
+    chunk_stats.emplace_back(dc_stats.dictionary, arenas[idx].GetResource());
   }
 
-  ranges::transform(drive_day, back_inserter(row), [](uint64_t number) {
-    return number == 0 ? "" : util::ToString(number);
+  util::RunParallel(*pool, chunk_count, [&reader, &months, &chunks,
+                                         &chunk_stats](size_t idx) {
+    StatsSink chunk_sink{chunk_stats[idx]};
+    csv::Reader chunk_reader{chunks[idx], reader.GetProjection()};
+    RecordParser{*chunk_stats[idx].dictionary, chunk_sink, months}.Parse(
+        chunk_reader);
   });
 
-  return row;
+  MergeParsedStats(dc_stats, chunk_stats, *pool);
 }
 
 //
 //
 //
-void WriteParsedStats(const DataCenterStats& dc_stats,
-                      const filesystem::path& file_path) {
-  rapidcsv::Document doc;
-
-  const vector header{MakeParsedStatsHeader(dc_stats)};
-  for (size_t idx = 0; idx < size(header); ++idx) {
-    doc.SetColumnName(idx, header[idx]);
+string RawStatsSource::GetName() const {
+  if (!archive) {
+    return file_path.string();
   }
+  return fmt::format("{}:{}", file_path.string(),
+                     archive->GetEntries()[entry_idx].name);
+}
 
-  size_t row_idx = 0;
-  for (const auto& [model_name, model_stats] : dc_stats.models) {
-    for (const auto& [serial_number, drive_stats] : model_stats.drives) {
-      vector row{MakeParsedStatsRow(dc_stats, model_name, model_stats,
-                                    serial_number, drive_stats)};
-      doc.SetRow(row_idx++, row);
+//
+// Names of archive members may include directories
+//
+optional<MonthIdx> RawStatsSource::GetMonth() const {
+  const auto name{
+      archive
+          ? filesystem::path{archive->GetEntries()[entry_idx].name}.filename()
+          : file_path.filename()};
+  const auto name_str{name.string()};
+  const string_view date{name_str};
+
+  // "size" is the member here
+  constexpr string_view kPattern{"0000-00-00"};
+  if (date.size() < kPattern.size()) {
+    return {};
+  }
+  for (size_t idx = 0; idx < kPattern.size(); ++idx) {
+    if (const auto ch = static_cast<unsigned char>(date[idx]);
+        kPattern[idx] == '-' ? ch != '-' : isdigit(ch) == 0) {
+      return {};
     }
   }
 
-  ofstream output{file_path, ios::binary};
-  output.exceptions(ios::badbit | ios::failbit);
-  doc.Save(output);
+  const auto month{util::ToInt<unsigned int>(date.substr(5, 2))};
+  if (month == 0 || month > kMonthPerYear) {
+    return {};
+  }
+  return MakeMonthIndex(util::ToInt<unsigned int>(date.substr(0, 4)), month);
 }
 
 //
 //
 //
-void MergeParsedStats(DataCenterStats& dc_stats,
-                      const DataCenterStats& other_stats) {
-  for (const auto& [model_name, other_model_stats] : other_stats.models) {
-    auto& model_stats{dc_stats.models[model_name]};
-    UpdateCapacity(model_name, model_stats, other_model_stats.capacity_bytes);
-
-    for (const auto& [serial_number, other_drive_stats] :
-         other_model_stats.drives) {
-      auto& drive_stats{model_stats.drives[serial_number]};
-      UpdateInitialPowerOnHour(serial_number, drive_stats,
-                               other_drive_stats.initial_power_on_hour);
-
-      auto& drive_day{drive_stats.drive_day};
-      for (const auto& [idx, value] : other_drive_stats.drive_day) {
-        drive_day[idx] += value;
+void ReadRawStats(DataCenterStats& dc_stats,
+                  const RawStatsSource& source,
+                  const MonthRange& months) {
+  if (!source.archive) {
+    ReadRawStats(dc_stats, source.file_path, months);
+    return;
+  }
+
+  StatsSink sink{dc_stats};
+  RecordParser parser{*dc_stats.dictionary, sink, months};
+  const auto stream{source.archive->OpenEntry(source.entry_idx)};
+  ReadRawStream(parser, *stream);
+}
+
+//
+//
+//
+void ReadRawStats(DataCenterStats& dc_stats,
+                  const RawStatsSource& source,
+                  const MonthRange& months,
+                  util::ThreadPool& pool) {
+  if (source.IsLargeFile()) {
+    ReadRawStats(dc_stats, source.file_path, months, &pool);
+  } else {
+    ReadRawStats(dc_stats, source, months);
+  }
+}
+
+//
+// Batches records for each shard; full batches are pushed to the queues
+//
+class ShardedStats::Producer : public RecordSink {
+ public:
+  Producer(ShardedStats& owner, size_t producer_idx)
+      : m_owner{owner},
+        m_producer_idx{producer_idx},
+        m_batches(owner.m_shard_count) {
+    for (auto& batch : m_batches) {
+      batch.reserve(kBatchSize);
+    }
+  }
+
+  void Add(span<const RawRecord> records) override {
+    for (const auto& record : records) {
+      const size_t shard_idx{record.drive_id % size(m_batches)};
+      auto& batch{m_batches[shard_idx]};
+      batch.push_back(record);
+      if (size(batch) == kBatchSize) {
+        m_owner.Push(m_producer_idx, shard_idx, batch);
+      }
+    }
+  }
+
+  void Flush() {
+    for (size_t shard_idx = 0; shard_idx < size(m_batches); ++shard_idx) {
+      if (!m_batches[shard_idx].empty()) {
+        m_owner.Push(m_producer_idx, shard_idx, m_batches[shard_idx]);
       }
+    }
+  }
 
-      auto& failure_date{drive_stats.failure_date};
-      const auto& other_failure_date{other_drive_stats.failure_date};
-      const auto middle{failure_date.insert(end(failure_date),
-                                            begin(other_failure_date),
-                                            end(other_failure_date))};
-      ranges::inplace_merge(failure_date, middle);
+ private:
+  ShardedStats& m_owner;
+  size_t m_producer_idx;
+  vector<Batch> m_batches;  // By shards
+};
+
+//
+// Shard threads are started last, since they access everything else
+//
+ShardedStats::ShardedStats(shared_ptr<DriveDictionary> dictionary,
+                           size_t shard_count,
+                           size_t producer_count)
+    : m_dictionary{move(dictionary)},
+      m_shard_count{shard_count},
+      m_producer_count{producer_count},
+      m_arenas{make_unique<util::Arena[]>(shard_count)},
+      m_queues{make_unique<BatchQueue[]>(producer_count * shard_count)},
+      m_signals{make_unique<atomic<uint32_t>[]>(shard_count)} {
+  m_shards.reserve(shard_count);
+  for (size_t idx = 0; idx < shard_count; ++idx) {
+    m_shards.emplace_back(m_dictionary, m_arenas[idx].GetResource());
+  }
+
+  m_producers.reserve(producer_count);
+  for (size_t idx = 0; idx < producer_count; ++idx) {
+    m_producers.push_back(make_unique<Producer>(*this, idx));
+  }
+
+  try {
+    m_threads.reserve(shard_count);
+    for (size_t idx = 0; idx < shard_count; ++idx) {
+      m_threads.emplace_back(&ShardedStats::RunShard, this, idx);
+    }
+  } catch (...) {
+    Finish();
+    throw;
+  }
+}
+
+//
+//
+//
+ShardedStats::~ShardedStats() {
+  try {
+    Finish();
+  } catch (...) {
+    util::PrintException(current_exception());
+  }
+}
+
+//
+//
+//
+RecordSink& ShardedStats::GetProducer(size_t producer_idx) noexcept {
+  return *m_producers[producer_idx];
+}
+
+//
+// Records are in the shards once the threads are joined
+//
+void ShardedStats::Finish() {
+  if (m_finished) {
+    return;
+  }
+
+  for (auto& producer : m_producers) {
+    producer->Flush();
+  }
+
+  m_finished = true;
+  for (size_t idx = 0; idx < m_shard_count; ++idx) {
+    m_signals[idx].fetch_add(1, memory_order_release);
+    m_signals[idx].notify_all();
+  }
+
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+  m_threads.clear();
+}
+
+//
+// Waits on the signal of the shard while the queue is full, since the
+// shard changes it after it pops batches. The signal is read before the
+// queue, so the wait returns at once if batches were popped after that.
+// The batch is empty afterwards
+//
+void ShardedStats::Push(size_t producer_idx, size_t shard_idx, Batch& batch) {
+  auto& queue{m_queues[producer_idx * m_shard_count + shard_idx]};
+  auto& signal{m_signals[shard_idx]};
+  for (;;) {
+    const uint32_t signal_value{signal.load(memory_order_acquire)};
+    if (queue.TryPush(batch)) {
+      break;
+    }
+    signal.wait(signal_value, memory_order_acquire);
+  }
+
+  batch.clear();
+  batch.reserve(kBatchSize);
+
+  signal.fetch_add(1, memory_order_release);
+  signal.notify_all();
+}
+
+//
+// The signal is read before the queues, so pushes after an empty pass
+// change it and the wait returns at once. Drives are stored at their ids
+// divided by the shard count
+//
+void ShardedStats::RunShard(size_t shard_idx) noexcept {
+  auto& signal{m_signals[shard_idx]};
+  auto& shard{m_shards[shard_idx]};
+
+  Batch batch;
+  while (true) {
+    const uint32_t signal_value{signal.load(memory_order_acquire)};
+    const bool finished{m_finished};
+
+    bool popped{false};
+    for (size_t producer_idx = 0; producer_idx < m_producer_count;
+         ++producer_idx) {
+      auto& queue{m_queues[producer_idx * m_shard_count + shard_idx]};
+      while (queue.TryPop(batch)) {
+        popped = true;
+        try {
+          shard.AddRecords(batch, m_shard_count);
+        } catch (...) {
+          util::PrintException(current_exception());
+        }
+      }
+    }
+
+    if (popped) {
+      // Wakes producers which wait for space
+      signal.fetch_add(1, memory_order_release);
+      signal.notify_all();
+    } else {
+      if (finished) {
+        break;
+      }
+      signal.wait(signal_value, memory_order_acquire);
+    }
+  }
+}
+
+//
+// Chunks of large files are parsed by tasks, which use producers of their
+// threads
+//
+void ReadRawStats(ShardedStats& sharded_stats,
+                  const RawStatsSource& source,
+                  const MonthRange& months,
+                  util::ThreadPool& pool) {
+  auto& dictionary{sharded_stats.GetDictionary()};
+  const auto get_sink{[&sharded_stats, &pool]() -> RecordSink& {
+    return sharded_stats.GetProducer(pool.GetThreadIdx());
+  }};
+
+  if (source.archive) {
+    RecordParser parser{dictionary, get_sink(), months};
+    const auto stream{source.archive->OpenEntry(source.entry_idx)};
+    ReadRawStream(parser, *stream);
+    return;
+  }
+
+  const util::MappedFile file{source.file_path};
+  if (const auto compression = util::DetectCompression(file.GetView());
+      compression != util::Compression::kNone) {
+    RecordParser parser{dictionary, get_sink(), months};
+    const auto stream{util::MakeDecompressor(file.GetView(), compression)};
+    ReadRawStream(parser, *stream);
+    return;
+  }
+
+  csv::Reader reader{file.GetView(), kRawColumns};
+
+  const auto records{reader.GetUnread()};
+  const size_t chunk_count{
+      source.IsLargeFile() ? GetChunkCount(records, &pool) : 1};
+  if (chunk_count == 1) {
+    RecordParser{dictionary, get_sink(), months}.Parse(reader);
+    return;
+  }
+
+  const vector chunks{SplitRawRecords(records, chunk_count, pool)};
+  util::RunParallel(pool, chunk_count, [&dictionary, &get_sink, &months,
+                                        &reader, &chunks](size_t idx) {
+    csv::Reader chunk_reader{chunks[idx], reader.GetProjection()};
+    RecordParser{dictionary, get_sink(), months}.Parse(chunk_reader);
+  });
+}
+
+//
+//
+//
+bool IsRawStatsFile(const filesystem::path& file_path) {
+  if (const auto extension = file_path.extension();
+      extension == ".gz" || extension == ".zst") {
+    return file_path.stem().extension() == ".csv";
+  } else {
+    return extension == ".csv";
+  }
+}
+
+//
+// macOS archivers add AppleDouble "._*" members under "__MACOSX/"
+//
+vector<RawStatsSource> ListArchiveSources(const filesystem::path& file_path) {
+  const auto archive{make_shared<const util::ZipArchive>(file_path)};
+  const auto entries{archive->GetEntries()};
+
+  vector<RawStatsSource> sources;
+  for (size_t idx = 0; idx < size(entries); ++idx) {
+    const filesystem::path entry_path{entries[idx].name};
+    if (entry_path.extension() == ".csv" &&
+        !entry_path.filename().string().starts_with("._") &&
+        !entries[idx].name.starts_with("__MACOSX/")) {
+      sources.push_back(
+          {file_path, archive, idx, entries[idx].uncompressed_size});
+    }
+  }
+
+  return sources;
+}
+
+//
+//
+//
+vector<RawStatsSource> ListRawStatsSources(
+    const filesystem::directory_entry& dir_entry) {
+  const filesystem::path file_path{dir_entry.path()};
+  if (IsRawStatsFile(file_path)) {
+    error_code ec;
+    const auto file_size{dir_entry.file_size(ec)};
+    return {{file_path, nullptr, 0, ec ? 0 : file_size}};
+  }
+
+  if (file_path.extension() == ".zip") {
+    spdlog::info("Opening {}", file_path.string());
+    return ListArchiveSources(file_path);
+  }
+
+  return {};
+}
+
+//
+// Part of a source for the parse stage of the pipeline; the owner keeps the
+// records in memory
+//
+struct RecordBlock {
+  shared_ptr<const void> owner;
+  string_view records;
+  shared_ptr<const csv::Projection> projection;
+};
+
+//
+// Source opened by the read stage: either a stream, or records of a mapped
+// file. The owner keeps the mapped data in memory
+//
+struct OpenedSource {
+  shared_ptr<const void> owner;
+  string_view data;  // Mapped data of the source
+  unique_ptr<util::InputStream> stream;
+  string_view records;
+  shared_ptr<const csv::Projection> projection;
+};
+
+//
+// Collects records of a block for the aggregate stage
+//
+class RecordCollector : public RecordSink {
+ public:
+  void Add(span<const RawRecord> records) override {
+    m_records.insert(end(m_records), begin(records), end(records));
+  }
+
+  vector<RawRecord> Take() noexcept { return exchange(m_records, {}); }
+
+ private:
+  vector<RawRecord> m_records;
+};
+
+//
+// Coroutines of each stage take values from the channel of the previous one,
+// and the last of them to finish closes the channel of the next stage, see
+// StageExit. Errors are reported and skip the source or the block. Values
+// are pushed from named variables, since GCC 12 mishandles braced
+// temporaries in co_await operands
+//
+class RawStatsPipeline {
+ public:
+  //
+  // The thread which waits for the fetch pool doesn't run its tasks while
+  // it waits for the main one, so the fetch pool has a worker per fetcher
+  //
+  RawStatsPipeline(DriveDictionary& dictionary,
+                   const EntryGenerator& next_entry,
+                   const ParseOptions& options,
+                   util::ThreadPool& pool)
+      : m_dictionary{dictionary},
+        m_next_entry{next_entry},
+        m_options{options},
+        m_pool{pool},
+        m_io_pool{options.io_threads == 0
+                      ? nullptr
+                      : make_unique<util::ThreadPool>(options.io_threads + 1)},
+        m_buffers{4 * pool.GetThreadCount() + options.io_threads},
+        m_sources{pool.GetThreadCount()},
+        m_opened{pool.GetThreadCount()},
+        m_blocks{2 * pool.GetThreadCount()},
+        m_records{pool.GetThreadCount()} {}
+
+  //
+  // Stats are indexed by threads of the pool. Readers, parsers and
+  // aggregators are as many as threads of the pool. With I/O threads,
+  // fetchers on a pool of their own take sources before readers
+  //
+  void Run(span<DataCenterStats> dc_stats) {
+    const size_t thread_count{m_pool.GetThreadCount()};
+    m_active_discoverers = 1;
+    m_active_readers = thread_count;
+    m_active_parsers = thread_count;
+    m_active_aggregators = thread_count;
+
+    optional<util::TaskGroup> io_group;
+    if (m_io_pool) {
+      io_group.emplace(*m_io_pool);
+      m_active_fetchers = m_options.io_threads;
+      for (size_t idx = 0; idx < m_options.io_threads; ++idx) {
+        Fetch().Start(*io_group);
+      }
+    }
+
+    util::TaskGroup group{m_pool};
+    Discover().Start(group);
+    for (size_t idx = 0; idx < thread_count; ++idx) {
+      Read().Start(group);
+      Parse().Start(group);
+    }
+    for (size_t idx = 0; idx < thread_count; ++idx) {
+      Aggregate(dc_stats).Start(group);
+    }
+    group.Wait();
+
+    if (io_group) {
+      io_group->Wait();
+    }
+  }
+
+ private:
+  //
+  // Runs the function when the last coroutine of a stage finishes, even by
+  // an exception, which is rethrown by the group. It closes the output of
+  // the stage, so the next one doesn't wait forever, and its input, so the
+  // previous one doesn't wait if the stage failed
+  //
+  template <class Fn>
+  class StageExit {
+   public:
+    StageExit(atomic<size_t>& active_count, Fn fn) noexcept
+        : m_active_count{active_count}, m_fn{std::move(fn)} {}
+    StageExit(const StageExit&) = delete;
+    StageExit& operator=(const StageExit&) = delete;
+
+    ~StageExit() {
+      if (--m_active_count == 0) {
+        m_fn();
+      }
+    }
+
+   private:
+    atomic<size_t>& m_active_count;
+    Fn m_fn;
+  };
+
+  //
+  // In largest-first order sources are sent after all of them are listed
+  //
+  util::Job Discover() {
+    const StageExit exit{m_active_discoverers,
+                         [this] { m_sources.Close(); }};
+    vector<RawStatsSource> sources;
+    for (;;) {
+      vector<RawStatsSource> entry_sources;
+      try {
+        const auto dir_entry{m_next_entry()};
+        if (!dir_entry) {
+          break;
+        }
+        entry_sources = ListRawStatsSources(*dir_entry);
+      } catch (...) {
+        util::PrintException(current_exception());
+      }
+
+      for (auto& source : entry_sources) {
+        if (m_options.largest_first) {
+          sources.push_back(std::move(source));
+        } else {
+          co_await m_sources.Push(std::move(source));
+        }
+      }
+    }
+
+    if (m_options.largest_first) {
+      ranges::stable_sort(sources, ranges::greater{}, &RawStatsSource::size);
+
+      uint64_t total_size{0};
+      for (const auto& source : sources) {
+        total_size += source.size;
+      }
+      spdlog::info("Sources: {}, {} MiB", size(sources),
+                   total_size / (1024 * 1024));
+
+      m_source_count = size(sources);
+      for (auto& source : sources) {
+        co_await m_sources.Push(std::move(source));
+      }
+    }
+  }
+
+  //
+  // Plain files are read into buffers by fetchers, so their reads wait in
+  // the I/O threads instead of page faults of parsers. Compression is
+  // detected by the first bytes of the file, and only compressed files are
+  // mapped. Mapped data of them and of archive members is read into memory
+  // before they are passed to readers, which decompress them
+  //
+  util::Job Fetch() {
+    const StageExit exit{m_active_fetchers, [this] {
+      m_sources.Close();
+      m_opened.Close();
+    }};
+    while (auto raw_source = co_await m_sources.Pop()) {
+      LogProcessing(*raw_source);
+
+      OpenedSource source;
+      unique_ptr<util::FileStream> file_stream;
+      array<char, util::kMaxMagicSize> magic;
+      size_t magic_size{0};
+      try {
+        if (!raw_source->archive) {
+          file_stream = make_unique<util::FileStream>(raw_source->file_path);
+          magic_size = file_stream->Read(magic);
+          if (util::DetectCompression({data(magic), magic_size}) !=
+              util::Compression::kNone) {
+            file_stream.reset();
+          }
+        }
+        if (!file_stream) {
+          source = Open(*raw_source);
+        }
+      } catch (...) {
+        util::PrintException(current_exception());
+        continue;
+      }
+
+      if (!file_stream) {
+        util::PrefetchPages(source.data.substr(0, kMaxPrefetchSize));
+        co_await m_opened.Push(std::move(source));
+        continue;
+      }
+
+      RecordStreamReader stream_reader{*file_stream, {data(magic), magic_size}};
+      shared_ptr<const csv::Projection> projection;
+      while (auto block = ReadBlock(stream_reader, projection)) {
+        co_await m_blocks.Push(std::move(*block));
+      }
+    }
+  }
+
+  //
+  // Sources are opened by readers unless they are fetched
+  //
+  util::Job Read() {
+    const StageExit exit{m_active_readers, [this] {
+      if (m_io_pool) {
+        m_opened.Close();
+      } else {
+        m_sources.Close();
+      }
+      m_blocks.Close();
+    }};
+    for (;;) {
+      OpenedSource source;
+      if (m_io_pool) {
+        auto fetched = co_await m_opened.Pop();
+        if (!fetched) {
+          break;
+        }
+        source = std::move(*fetched);
+      } else {
+        const auto raw_source = co_await m_sources.Pop();
+        if (!raw_source) {
+          break;
+        }
+
+        LogProcessing(*raw_source);
+        try {
+          source = Open(*raw_source);
+        } catch (...) {
+          util::PrintException(current_exception());
+          continue;
+        }
+      }
+
+      // Blocks of a mapped file are views of the mapping, which is unmapped
+      // with the last of them
+      if (!source.stream) {
+        while (!source.records.empty()) {
+          const size_t block_size{GetBlockSize(source.records)};
+          RecordBlock block{source.owner, source.records.substr(0, block_size),
+                            source.projection};
+          co_await m_blocks.Push(std::move(block));
+          source.records.remove_prefix(block_size);
+        }
+        continue;
+      }
+
+      RecordStreamReader stream_reader{*source.stream};
+      while (auto block = ReadBlock(stream_reader, source.projection)) {
+        co_await m_blocks.Push(std::move(*block));
+      }
+    }
+  }
+
+  //
+  // Records of each block are sent at once
+  //
+  util::Job Parse() {
+    const StageExit exit{m_active_parsers, [this] {
+      m_blocks.Close();
+      m_records.Close();
+    }};
+    RecordCollector collector;
+    RecordParser parser{m_dictionary, collector, m_options.months};
+    while (auto block = co_await m_blocks.Pop()) {
+      try {
+        csv::Reader reader{block->records, *block->projection};
+        parser.Parse(reader);
+      } catch (...) {
+        util::PrintException(current_exception());
+      }
+
+      // The buffer or the mapping may be released before records are added
+      block.reset();
+      if (auto records = collector.Take(); !records.empty()) {
+        co_await m_records.Push(std::move(records));
+      }
+    }
+  }
+
+  //
+  // The coroutine may move between threads, so records are added to the
+  // stats of the thread which runs it. A thread runs a single task at a
+  // time, so its stats and arena are only touched by it, e.g. on the NUMA
+  // node of a pinned worker
+  //
+  util::Job Aggregate(span<DataCenterStats> dc_stats) {
+    const StageExit exit{m_active_aggregators,
+                         [this] { m_records.Close(); }};
+    while (auto records = co_await m_records.Pop()) {
+      StatsSink{dc_stats[m_pool.GetThreadIdx()]}.Add(*records);
+    }
+  }
+
+  //
+  //
+  //
+  void LogProcessing(const RawStatsSource& source) {
+    if (const auto number = ++m_started_count; m_source_count != 0) {
+      spdlog::info("Processing {} ({}/{})", source.GetName(), number,
+                   m_source_count);
+    } else {
+      spdlog::info("Processing {}", source.GetName());
+    }
+  }
+
+  //
+  // Members of archives and compressed files are read by a stream; columns
+  // of plain files are found by the header
+  //
+  static OpenedSource Open(const RawStatsSource& source) {
+    OpenedSource opened;
+    if (source.archive) {
+      opened.owner = source.archive;
+      opened.data = source.archive->GetEntryData(source.entry_idx);
+      opened.stream = source.archive->OpenEntry(source.entry_idx);
+      return opened;
+    }
+
+    const auto file{make_shared<const util::MappedFile>(source.file_path)};
+    opened.owner = file;
+    opened.data = file->GetView();
+    if (const auto compression = util::DetectCompression(opened.data);
+        compression != util::Compression::kNone) {
+      opened.stream = util::MakeDecompressor(opened.data, compression);
+    } else {
+      const csv::Reader reader{opened.data, kRawColumns};
+      opened.projection =
+          make_shared<const csv::Projection>(reader.GetProjection());
+      opened.records = reader.GetUnread();
+    }
+    return opened;
+  }
+
+  //
+  // Next block of the stream in a buffer of the pool; none at the end of
+  // the stream or after an error, which is reported. Blocks own their
+  // buffers, since the next block is read while they are parsed, and blocks
+  // read before an error are parsed. Columns are found by the header in the
+  // first block
+  //
+  optional<RecordBlock> ReadBlock(
+      RecordStreamReader& stream_reader,
+      shared_ptr<const csv::Projection>& projection) {
+    try {
+      for (;;) {
+        auto buffer{m_buffers.Acquire()};
+        if (!stream_reader.Read(*buffer)) {
+          return {};
+        }
+
+        string_view records{data(*buffer), size(*buffer)};
+        if (!projection) {
+          const csv::Reader reader{records, kRawColumns};
+          projection =
+              make_shared<const csv::Projection>(reader.GetProjection());
+          records = reader.GetUnread();
+        }
+
+        if (!records.empty()) {
+          return RecordBlock{std::move(buffer), records, projection};
+        }
+      }
+    } catch (...) {
+      util::PrintException(current_exception());
+      return {};
+    }
+  }
+
+  //
+  // Size of the first block of complete records, which is about
+  // kStreamBufferSize unless a record is larger
+  //
+  static size_t GetBlockSize(string_view records) {
+    for (size_t window = kStreamBufferSize; window < size(records);
+         window *= 2) {
+      if (const size_t block_size =
+              csv::FindCompleteRecords(records.substr(0, window));
+          block_size != 0) {
+        return block_size;
+      }
+    }
+    return size(records);
+  }
+
+ private:
+  DriveDictionary& m_dictionary;
+  const EntryGenerator& m_next_entry;
+  const ParseOptions& m_options;
+  util::ThreadPool& m_pool;
+  unique_ptr<util::ThreadPool> m_io_pool;  // Of fetchers, if any
+  util::BufferPool m_buffers;  // Of stream blocks
+
+  util::Channel<RawStatsSource> m_sources;
+  util::Channel<OpenedSource> m_opened;  // From fetchers to readers
+  util::Channel<RecordBlock> m_blocks;
+  util::Channel<vector<RawRecord>> m_records;
+
+  size_t m_source_count{0};  // Known only in largest-first order
+  atomic<size_t> m_started_count{0};
+  atomic<size_t> m_active_discoverers{0};
+  atomic<size_t> m_active_fetchers{0};
+  atomic<size_t> m_active_readers{0};
+  atomic<size_t> m_active_parsers{0};
+  atomic<size_t> m_active_aggregators{0};
+};
+
+//
+// Each thread of the pool has stats of its own in an arena. The largest
+// stats become the result, and other arenas are released at once after the
+// merge
+//
+DataCenterStats ParseRawStats(const EntryGenerator& next_entry,
+                              const ParseOptions& options,
+                              util::ThreadPool& pool) {
+  const size_t thread_count{pool.GetThreadCount()};
+
+  const auto dictionary{make_shared<DriveDictionary>()};
+  vector<DataCenterStats> dc_stats;
+  dc_stats.reserve(thread_count);
+  for (size_t idx = 0; idx < thread_count; ++idx) {
+    dc_stats.emplace_back(dictionary, make_shared<util::Arena>());
+  }
+
+  RawStatsPipeline{*dictionary, next_entry, options, pool}.Run(dc_stats);
+  return MergeParsedStats(std::move(dc_stats), pool);
+}
+
+//
+// Model names are taken from the dictionary once, since it's locked for them
+//
+struct OutputModel {
+  string_view name;
+  string capacity;
+};
+
+//
+// Columns of the output, which are common for all stats being written
+//
+struct OutputLayout {
+  MonthRange month_range{numeric_limits<MonthIdx>::max(), 0};
+  size_t max_failure{0};
+  vector<OutputModel> models;
+
+  //
+  // Columns of months between the first and the last one with any records
+  //
+  size_t GetMonthCount() const noexcept {
+    const auto& [first, last]{month_range};
+    return first <= last ? size_t{last} - first + 1 : 0;
+  }
+};
+
+//
+// Capacities of models are the largest ones among the stats
+//
+static OutputLayout MakeOutputLayout(span<const DataCenterStats> dc_stats) {
+  OutputLayout layout;
+  vector<optional<uint64_t>> model_capacity;
+  for (const auto& stats : dc_stats) {
+    layout.month_range.first =
+        min(layout.month_range.first, stats.month_range.first);
+    layout.month_range.last =
+        max(layout.month_range.last, stats.month_range.last);
+    layout.max_failure = max(layout.max_failure, size_t{stats.max_failure});
+
+    if (size(stats.model_capacity) > size(model_capacity)) {
+      model_capacity.resize(size(stats.model_capacity));
+    }
+    for (size_t model_id = 0; model_id < size(stats.model_capacity);
+         ++model_id) {
+      model_capacity[model_id] =
+          max(model_capacity[model_id], stats.model_capacity[model_id]);
+    }
+  }
+
+  if (dc_stats.empty()) {
+    return layout;
+  }
+
+  const auto& dictionary{*dc_stats.front().dictionary};
+  layout.models.resize(size(model_capacity));
+  for (size_t model_id = 0; model_id < size(model_capacity); ++model_id) {
+    layout.models[model_id] = {
+        dictionary.GetModelName(static_cast<ModelId>(model_id)),
+        util::ToString(model_capacity[model_id])};
+  }
+
+  return layout;
+}
+
+//
+//
+//
+static void WriteParsedStatsHeader(const OutputLayout& layout,
+                                   csv::Writer& writer) {
+  for (const auto& prefix : kOutputPrefix) {
+    writer.WriteField(prefix);
+  }
+
+  for (size_t idx = 0; idx < layout.max_failure; ++idx) {
+    writer.WriteField(fmt::format("failure_{}", idx + 1));
+  }
+
+  for (size_t offset = 0; offset < layout.GetMonthCount(); ++offset) {
+    const size_t month_idx{layout.month_range.first + offset};
+    writer.WriteField(fmt::format("date_{}_{}", month_idx / kMonthPerYear,
+                                  month_idx % kMonthPerYear + 1));
+  }
+
+  writer.EndRecord();
+}
+
+//
+// Columns of the drive are at 'drive_idx'
+//
+static void WriteParsedStatsRow(const OutputLayout& layout,
+                                const DataCenterStats& dc_stats,
+                                DriveId drive_idx,
+                                DriveId drive_id,
+                                csv::Writer& writer) {
+  const auto& dictionary{*dc_stats.dictionary};
+  const auto& model{layout.models[dictionary.GetModel(drive_id)]};
+  writer.WriteField(model.name);
+  writer.WriteField(dictionary.GetSerialNumber(drive_id));
+  writer.WriteField(model.capacity);
+
+  if (const auto& power_on_hour = dc_stats.initial_power_on_hour[drive_idx]) {
+    writer.WriteField(*power_on_hour);
+  } else {
+    writer.WriteEmptyFields(1);
+  }
+
+  const auto& failure_date{dc_stats.failure_date[drive_idx]};
+  for (const auto day : failure_date) {
+    writer.WriteField(util::ToString(GetDate(day)));
+  }
+
+  writer.WriteEmptyFields(layout.max_failure - size(failure_date));
+
+  for (size_t offset = 0; offset < layout.GetMonthCount(); ++offset) {
+    const auto month_idx{
+        static_cast<MonthIdx>(layout.month_range.first + offset)};
+    if (const auto number = dc_stats.drive_day.Get(month_idx, drive_idx)) {
+      writer.WriteField(unsigned{number});
+    } else {
+      writer.WriteEmptyFields(1);
+    }
+  }
+
+  writer.EndRecord();
+}
+
+//
+// Drives are written in the order of their ids
+//
+void WriteParsedStats(const DataCenterStats& dc_stats,
+                      const filesystem::path& file_path,
+                      util::ThreadPool& pool) {
+  WriteParsedStats(span{&dc_stats, 1}, file_path, pool);
+}
+
+//
+// Tasks format ranges of drives of each shard into separate buffers, which
+// are then written one after another. Drive at index i of shard s of N has
+// id i * N + s
+//
+void WriteParsedStats(span<const DataCenterStats> shards,
+                      const filesystem::path& file_path,
+                      util::ThreadPool& pool) {
+  const OutputLayout layout{MakeOutputLayout(shards)};
+
+  struct DriveRange {
+    size_t shard_idx;
+    size_t first_idx;
+  };
+
+  vector<DriveRange> ranges;
+  for (size_t shard_idx = 0; shard_idx < size(shards); ++shard_idx) {
+    for (size_t first_idx = 0; first_idx < shards[shard_idx].GetDriveCount();
+         first_idx += kWriteRangeSize) {
+      ranges.push_back({shard_idx, first_idx});
+    }
+  }
+
+  vector<string> buffers(size(ranges));
+  util::RunParallel(pool, size(ranges), [&layout, &shards, &ranges,
+                                         &buffers](size_t idx) {
+    const auto [shard_idx, first_idx]{ranges[idx]};
+    const auto& shard{shards[shard_idx]};
+
+    csv::Writer writer{buffers[idx]};
+    const size_t last_idx{
+        min(shard.GetDriveCount(), first_idx + kWriteRangeSize)};
+    for (size_t drive_idx = first_idx; drive_idx < last_idx; ++drive_idx) {
+      WriteParsedStatsRow(
+          layout, shard, static_cast<DriveId>(drive_idx),
+          static_cast<DriveId>(drive_idx * size(shards) + shard_idx), writer);
+    }
+  });
+
+  string header;
+  csv::Writer writer{header};
+  WriteParsedStatsHeader(layout, writer);
+
+  ofstream output{file_path, ios::binary};
+  output.exceptions(ios::badbit | ios::failbit);
+  output << header;
+  for (const auto& buffer : buffers) {
+    output << buffer;
+  }
+}
+
+//
+// Merges everything but drive columns; they are extended to cover drives of
+// the other stats, except for drive days
+//
+static void MergeModels(DataCenterStats& dc_stats,
+                        const DataCenterStats& other_stats) {
+  if (dc_stats.dictionary != other_stats.dictionary) {
+    throw invalid_argument{"Stats have different dictionaries"};
+  }
+  const auto& dictionary{*dc_stats.dictionary};
+
+  dc_stats.UpdateMonthRange(other_stats.month_range);
+
+  const size_t model_count{size(other_stats.model_capacity)};
+  if (model_count > size(dc_stats.model_capacity)) {
+    dc_stats.model_capacity.resize(model_count);
+  }
+
+  for (size_t model_id = 0; model_id < model_count; ++model_id) {
+    if (const auto& capacity = other_stats.model_capacity[model_id]) {
+      UpdateCapacity(dictionary, static_cast<ModelId>(model_id),
+                     dc_stats.model_capacity[model_id], capacity);
+    }
+  }
+
+  const size_t drive_count{other_stats.GetDriveCount()};
+  if (drive_count > dc_stats.GetDriveCount()) {
+    dc_stats.initial_power_on_hour.resize(drive_count);
+    dc_stats.failure_date.resize(drive_count);
+  }
+}
+
+//
+// Dates of both are sorted
+//
+static void MergeFailureDates(DataCenterStats::FailureDates& failure_date,
+                              const DataCenterStats::FailureDates& other) {
+  const auto middle{
+      failure_date.insert(end(failure_date), begin(other), end(other))};
+  ranges::inplace_merge(failure_date, middle);
+}
+
+//
+// Columns of drives in [first_id, last_id) are merged element-wise, since
+// ids are the same in both stats. Failure dates may allocate, so drives
+// with them are only collected for MergeFailureDates
+//
+static void MergeDrives(DataCenterStats& dc_stats,
+                        const DataCenterStats& other_stats,
+                        DriveId first_id,
+                        DriveId last_id,
+                        vector<DriveId>& failed_ids) {
+  const auto& dictionary{*dc_stats.dictionary};
+  const size_t last{min<size_t>(other_stats.GetDriveCount(), last_id)};
+
+  for (size_t drive_id = first_id; drive_id < last; ++drive_id) {
+    if (const auto& power_on_hour =
+            other_stats.initial_power_on_hour[drive_id]) {
+      UpdateInitialPowerOnHour(dictionary, static_cast<DriveId>(drive_id),
+                               dc_stats.initial_power_on_hour[drive_id],
+                               power_on_hour);
+    }
+
+    if (!other_stats.failure_date[drive_id].empty()) {
+      failed_ids.push_back(static_cast<DriveId>(drive_id));
+    }
+  }
+
+  dc_stats.drive_day.Add(other_stats.drive_day, first_id, last_id);
+}
+
+//
+// Few drives fail, so their dates are merged by a single thread
+//
+static void MergeFailureDates(DataCenterStats& dc_stats,
+                              const DataCenterStats& other_stats,
+                              span<const DriveId> failed_ids) {
+  for (const DriveId drive_id : failed_ids) {
+    auto& failure_date{dc_stats.failure_date[drive_id]};
+    MergeFailureDates(failure_date, other_stats.failure_date[drive_id]);
+    dc_stats.UpdateMaxFailure(size(failure_date));
+  }
+}
+
+//
+//
+//
+void MergeParsedStats(DataCenterStats& dc_stats,
+                      const DataCenterStats& other_stats) {
+  MergeModels(dc_stats, other_stats);
+  dc_stats.drive_day.Reserve(other_stats.drive_day);
+
+  vector<DriveId> failed_ids;
+  MergeDrives(dc_stats, other_stats, 0, numeric_limits<DriveId>::max(),
+              failed_ids);
+  MergeFailureDates(dc_stats, other_stats, failed_ids);
+}
+
+//
+// Columns are extended for all stats first, so tasks write disjoint cells
+// without reallocations. Each task merges all stats for its range of ids,
+// which keeps them in the cache
+//
+void MergeParsedStats(DataCenterStats& dc_stats,
+                      span<const DataCenterStats> other_stats,
+                      util::ThreadPool& pool) {
+  for (const auto& stats : other_stats) {
+    MergeModels(dc_stats, stats);
+    dc_stats.drive_day.Reserve(stats.drive_day);
+  }
+
+  // By ranges, then stats
+  const size_t drive_count{dc_stats.GetDriveCount()};
+  const size_t range_count{(drive_count + kMergeRangeSize - 1) /
+                           kMergeRangeSize};
+  vector<vector<DriveId>> failed_ids(range_count * size(other_stats));
+  util::RunParallel(pool, range_count, [&dc_stats, &other_stats,
+                                        &failed_ids](size_t idx) {
+    const auto first_id{static_cast<DriveId>(idx * kMergeRangeSize)};
+    const auto last_id{static_cast<DriveId>(first_id + kMergeRangeSize)};
+    for (size_t stats_idx = 0; stats_idx < size(other_stats); ++stats_idx) {
+      MergeDrives(dc_stats, other_stats[stats_idx], first_id, last_id,
+                  failed_ids[idx * size(other_stats) + stats_idx]);
+    }
+  });
+
+  for (size_t idx = 0; idx < size(failed_ids); ++idx) {
+    MergeFailureDates(dc_stats, other_stats[idx % size(other_stats)],
+                      failed_ids[idx]);
+  }
+}
+
+//
+// The moved stats are replaced by empty ones, since erasing them would move
+// the others between arenas, i.e. copy them
+//
+DataCenterStats MergeParsedStats(vector<DataCenterStats>&& dc_stats,
+                                 util::ThreadPool& pool) {
+  if (dc_stats.empty()) {
+    throw invalid_argument{"No stats to merge"};
+  }
+
+  const auto largest{
+      ranges::max_element(dc_stats, {}, &DataCenterStats::GetDriveCount)};
+  DataCenterStats result{std::move(*largest)};
+  *largest = DataCenterStats{result.dictionary};
+
+  MergeParsedStats(result, dc_stats, pool);
+  return result;
+}
+
+//
+// Failure dates of the other stats are later than those of 'dc_stats', so
+// they are appended after the tasks, see MergeDrives
+//
+static void SpliceDrives(DataCenterStats& dc_stats,
+                         const DataCenterStats& other_stats,
+                         DriveId first_id,
+                         DriveId last_id,
+                         vector<DriveId>& failed_ids) {
+  const auto& dictionary{*dc_stats.dictionary};
+  const size_t last{min<size_t>(other_stats.GetDriveCount(), last_id)};
+
+  for (size_t drive_id = first_id; drive_id < last; ++drive_id) {
+    if (const auto& power_on_hour =
+            other_stats.initial_power_on_hour[drive_id]) {
+      UpdateInitialPowerOnHour(dictionary, static_cast<DriveId>(drive_id),
+                               dc_stats.initial_power_on_hour[drive_id],
+                               power_on_hour);
+    }
+
+    if (!other_stats.failure_date[drive_id].empty()) {
+      failed_ids.push_back(static_cast<DriveId>(drive_id));
+    }
+  }
+}
+
+//
+// Month ranges are compared before MergeModels extends the range
+//
+void SpliceParsedStats(DataCenterStats& dc_stats,
+                       const DataCenterStats& other_stats,
+                       util::ThreadPool& pool) {
+  if (const auto& range = dc_stats.month_range;
+      range.first <= range.last &&
+      other_stats.month_range.first <= range.last) {
+    MergeParsedStats(dc_stats, span{&other_stats, 1}, pool);
+    return;
+  }
+
+  MergeModels(dc_stats, other_stats);
+  dc_stats.drive_day.Splice(other_stats.drive_day);
+
+  const size_t drive_count{other_stats.GetDriveCount()};
+  vector<vector<DriveId>> failed_ids((drive_count + kMergeRangeSize - 1) /
+                                     kMergeRangeSize);
+  util::RunParallel(pool, size(failed_ids), [&dc_stats, &other_stats,
+                                             &failed_ids](size_t idx) {
+    const auto first_id{static_cast<DriveId>(idx * kMergeRangeSize)};
+    const auto last_id{static_cast<DriveId>(first_id + kMergeRangeSize)};
+    SpliceDrives(dc_stats, other_stats, first_id, last_id, failed_ids[idx]);
+  });
 
+  for (const auto& ids : failed_ids) {
+    for (const DriveId drive_id : ids) {
+      auto& failure_date{dc_stats.failure_date[drive_id]};
+      const auto& other_failure_date{other_stats.failure_date[drive_id]};
+      failure_date.insert(end(failure_date), begin(other_failure_date),
+                          end(other_failure_date));
       dc_stats.UpdateMaxFailure(size(failure_date));
     }
   }
 }
-}  // namespace bb
\ No newline at end of file
+}  // namespace bb
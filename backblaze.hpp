@@ -1,19 +1,36 @@
 #pragma once
 #include <fmt/format.h>
 #include <spdlog/spdlog.h>
-#include <boost/container/small_vector.hpp>
 #include "unordered_dense/include/ankerl/unordered_dense.h"
-
+#include "arena.hpp"
+#include "drive_dictionary.hpp"
+#include "interner.hpp"
+#include "spsc_queue.hpp"
+#include "thread_pool.hpp"
+#include "zip.hpp"
+
+#include <algorithm>
+#include <atomic>
 #include <charconv>
 #include <chrono>
 #include <concepts>
 #include <cstdint>
+#include <deque>
+#include <exception>
 #include <filesystem>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <system_error>
 #include <thread>
+#include <vector>
 
 //
 //
@@ -115,150 +132,728 @@ inline constexpr uint64_t kMinCapacityBytes{BytesToGBytes(40)};
 //
 inline constexpr uint64_t kMaxCapacityBytes{BytesToTBytes(40)};
 
+//
+// Files of this size and larger are split into tasks of the thread pool
+//
+inline constexpr uint64_t kLargeFileSize{256 * 1024 * 1024};
+
 //
 //
 //
-inline constexpr uint16_t kFirstYear{2013};
-inline constexpr uint16_t kLastYear{2023};
 inline constexpr uint8_t kMonthPerYear{12};
-inline constexpr uint8_t kDateLength{3};
 
 //
+// Months since January of year 0, so consecutive months have consecutive
+// indexes
+//
+using MonthIdx = uint32_t;
+
 //
+// Closed range of months
 //
-inline constexpr std::array kOutputPrefix{
-    "model", "serial_number", "capacity_bytes", "initial_power_on_hour"};
+struct MonthRange {
+  MonthIdx first{0};
+  MonthIdx last{std::numeric_limits<MonthIdx>::max()};
+
+  bool Contains(MonthIdx month_idx) const noexcept {
+    return month_idx >= first && month_idx <= last;
+  }
+};
 
 //
+// "YYYY-MM"
+//
+MonthIdx ParseMonth(std::string_view str);
+
 //
+// Options of ParseRawStats
 //
-struct DriveStats {
-  using Counters = ankerl::unordered_dense::map<uint8_t, uint8_t>;
-  using Dates = boost::container::small_vector<Date, 1>;
+struct ParseOptions {
+  MonthRange months;
 
-  static constexpr size_t kCounterCount{(kLastYear - kFirstYear + 1) *
-                                        static_cast<size_t>(kMonthPerYear)};
-  static_assert(kCounterCount <= std::numeric_limits<Counters::key_type>::max(),
-                "Too many counters");
+  //
+  // All sources are listed before parsing and dispatched from the largest
+  // one, so a large late file doesn't leave other threads idle at the end
+  //
+  bool largest_first{false};
 
-  std::optional<uint32_t> initial_power_on_hour;
-  Counters drive_day;
-  Dates failure_date;
+  //
+  // Parsed records are routed to shards of drives instead of being
+  // collected by each thread, see ShardedStats
+  //
+  bool sharded{false};
+
+  //
+  // Sources are assigned to tasks by contiguous ranges of dates in their
+  // names, so stats of tasks cover disjoint months and are spliced instead
+  // of being added, see SpliceParsedStats. Not combined with largest_first
+  // and sharded
+  //
+  bool by_date{false};
+
+  //
+  // Threads of their own read plain files into buffers and other sources
+  // into memory ahead of the pool, so parsers don't wait on I/O, e.g. of
+  // network or spinning storage. 0 reads sources by threads of the pool
+  //
+  size_t io_threads{0};
 };
 
 //
+// Days since kEpoch; 16 bits cover dates up to 2192
+//
+using DayNumber = uint16_t;
+
 //
+// Backblaze data starts in 2013
 //
-using SerialNumber = std::string;
+inline constexpr std::chrono::sys_days kEpoch{std::chrono::year{2013} /
+                                              std::chrono::January / 1};
 
 //
 //
 //
-struct ModelStats {
-  using DriveMap = ankerl::unordered_dense::map<SerialNumber, DriveStats>;
+inline constexpr std::array kOutputPrefix{
+    "model", "serial_number", "capacity_bytes", "initial_power_on_hour"};
 
-  DriveMap drives;
-  std::optional<uint64_t> capacity_bytes;
+//
+// Drive days by months (rows) and drives (columns). Rows span months from
+// the first to the last touched one and end at the largest drive id in them
+//
+class DriveDayMatrix {
+ public:
+  using Value = uint8_t;
+  using Row = std::pmr::vector<Value>;
+
+ public:
+  explicit DriveDayMatrix(std::pmr::memory_resource* resource =
+                              std::pmr::get_default_resource())
+      : m_months{resource} {}
+
+  //
+  // Row of the month for direct updates by drive ids; rows are extended to
+  // it, but cells are extended by the caller. The reference is valid until
+  // rows of other months are added
+  //
+  Row& GetMonth(MonthIdx month_idx);
+
+  //
+  // Cells outside of the stored range are 0
+  //
+  Value Get(MonthIdx month_idx, DriveId drive_id) const noexcept {
+    if (const size_t offset = month_idx - m_first_month;
+        offset < std::size(m_months) &&
+        drive_id < std::size(m_months[offset])) {
+      return m_months[offset][drive_id];
+    }
+    return 0;
+  }
+
+  //
+  // Element-wise sum
+  //
+  void Add(const DriveDayMatrix& other);
+
+  //
+  // Extends rows to cover cells of the other matrix, so that ranges of it
+  // can be added concurrently
+  //
+  void Reserve(const DriveDayMatrix& other);
+
+  //
+  // Element-wise sum of columns [first_id, last_id); the matrix must be
+  // reserved for the other one
+  //
+  void Add(const DriveDayMatrix& other, DriveId first_id, DriveId last_id);
+
+  //
+  // Copies rows of the other matrix, which must start after the last row of
+  // this one
+  //
+  void Splice(const DriveDayMatrix& other);
+
+ private:
+  void Extend(MonthIdx month_idx, DriveId drive_id);
+
+ private:
+  std::pmr::vector<Row> m_months;
+  MonthIdx m_first_month{0};
 };
 
 //
+// Record of raw stats with ids resolved by the dictionary
 //
-//
-using ModelName = std::string;
+struct RawRecord {
+  DriveId drive_id;
+  ModelId model_id;
+  MonthIdx month_idx;
+  DayNumber day;
+  bool failure;
+  std::optional<uint32_t> initial_power_on_hour;
+  std::optional<uint64_t> capacity_bytes;  // Empty if it's invalid
+};
 
 //
+// Receives parsed records by batches
 //
+class RecordSink {
+ public:
+  virtual ~RecordSink() = default;
+
+  virtual void Add(std::span<const RawRecord> records) = 0;
+};
+
+//
+// Stats are stored in columns indexed by ids of the dictionary, which is
+// shared by all stats being merged, so each drive has the same id in all of
+// them. All containers allocate from the memory resource, e.g. a util::Arena
+// of the thread, which must outlive them unless the stats own it
 //
 struct DataCenterStats {
-  using ModelMap = ankerl::unordered_dense::map<ModelName, ModelStats>;
+  using FailureDates = std::pmr::vector<DayNumber>;
+
+  std::shared_ptr<util::Arena> arena;  // Released after the containers
+  std::shared_ptr<DriveDictionary> dictionary;
+
+  std::pmr::vector<std::optional<uint64_t>> model_capacity;
+
+  std::pmr::vector<std::optional<uint32_t>> initial_power_on_hour;
+  std::pmr::vector<FailureDates> failure_date;
+  DriveDayMatrix drive_day;
 
-  ModelMap models;
   uint64_t max_failure = 0;
+  MonthRange month_range{std::numeric_limits<MonthIdx>::max(), 0};  // Empty
+
+  explicit DataCenterStats(std::shared_ptr<DriveDictionary> drive_dictionary,
+                           std::pmr::memory_resource* resource =
+                               std::pmr::get_default_resource())
+      : dictionary{std::move(drive_dictionary)},
+        model_capacity{resource},
+        initial_power_on_hour{resource},
+        failure_date{resource},
+        drive_day{resource} {}
+
+  //
+  // Moved stats keep their arena, so they may outlive its creator
+  //
+  DataCenterStats(std::shared_ptr<DriveDictionary> drive_dictionary,
+                  std::shared_ptr<util::Arena> memory)
+      : DataCenterStats{std::move(drive_dictionary), memory->GetResource()} {
+    arena = std::move(memory);
+  }
+
+  //
+  // Columns of drives are at their ids divided by 'id_divisor', which is the
+  // shard count of a shard; they are extended up to them. The month range
+  // and the drive-day row are updated once per run of records of the same
+  // month, which is usually a whole batch as daily files have a single date
+  //
+  void AddRecords(std::span<const RawRecord> records, size_t id_divisor = 1);
+
+  //
+  // Ids of drives which weren't added to these stats have empty columns
+  //
+  size_t GetDriveCount() const noexcept {
+    return std::size(initial_power_on_hour);
+  }
 
   void UpdateMaxFailure(size_t failure_count) noexcept {
     if (failure_count > max_failure) {
       max_failure = failure_count;
     }
   }
+
+  void UpdateMonthRange(const MonthRange& range) noexcept {
+    month_range.first = std::min(month_range.first, range.first);
+    month_range.last = std::max(month_range.last, range.last);
+  }
+
+ private:
+  void AddRecord(const RawRecord& record,
+                 DriveId drive_idx,
+                 DriveDayMatrix::Row& month);
+};
+
+//
+// Stats split into shards by drive ids: shard s of N holds drives s, s + N,
+// s + 2N... at indexes 0, 1, 2..., so each drive is in a single shard and
+// shards aren't merged. Each shard is owned by its thread, which takes
+// batches of records from a bounded SPSC queue of each producer. Memory of
+// stats doesn't grow with the number of producers
+//
+class ShardedStats {
+ public:
+  ShardedStats(std::shared_ptr<DriveDictionary> dictionary,
+               size_t shard_count,
+               size_t producer_count);
+  ShardedStats(const ShardedStats&) = delete;
+  ShardedStats& operator=(const ShardedStats&) = delete;
+  ~ShardedStats();
+
+  //
+  // A shard thread per 4 threads of the budget, which are taken out of the
+  // producers' pool, so the threads don't exceed it
+  //
+  static size_t GetShardCount(size_t thread_count) noexcept {
+    return std::max<size_t>(thread_count / 4, 1);
+  }
+
+  DriveDictionary& GetDictionary() const noexcept { return *m_dictionary; }
+
+  //
+  // Each producer must be used by a single thread at a time
+  //
+  RecordSink& GetProducer(size_t producer_idx) noexcept;
+
+  //
+  // Flushes producers, which must be idle, and waits for shard threads
+  // to take all records
+  //
+  void Finish();
+
+  std::span<const DataCenterStats> GetShards() const noexcept {
+    return m_shards;
+  }
+
+ private:
+  class Producer;
+
+  //
+  // Records of a producer for a shard
+  //
+  using Batch = std::vector<RawRecord>;
+  using BatchQueue = util::SpscQueue<Batch, 8>;
+
+  static constexpr size_t kBatchSize{256};
+
+ private:
+  void Push(size_t producer_idx, size_t shard_idx, Batch& batch);
+  void RunShard(size_t shard_idx) noexcept;
+
+ private:
+  std::shared_ptr<DriveDictionary> m_dictionary;
+  size_t m_shard_count;
+  size_t m_producer_count;
+
+  std::unique_ptr<util::Arena[]> m_arenas;
+  std::vector<DataCenterStats> m_shards;
+
+  std::unique_ptr<BatchQueue[]> m_queues;  // By producers, then shards
+  std::vector<std::unique_ptr<Producer>> m_producers;
+
+  // Incremented after pushes to wake the shard thread, and after pops to
+  // wake producers which wait for space
+  std::unique_ptr<std::atomic<uint32_t>[]> m_signals;
+  std::atomic<bool> m_finished{false};
+  std::vector<std::thread> m_threads;
+};
+
+//
+// Large files are split into ranges of records which are parsed by tasks
+// of the pool, if it's given. Files compressed with gzip or zstd (detected
+// by magic bytes) are decompressed on the fly by a single thread. Records
+// of months outside of 'months' are skipped
+//
+void ReadRawStats(DataCenterStats& dc_stats,
+                  const std::filesystem::path& file_path,
+                  const MonthRange& months,
+                  util::ThreadPool* pool = nullptr);
+
+//
+// CSV file or a CSV member of a zip archive
+//
+struct RawStatsSource {
+  std::filesystem::path file_path;
+  std::shared_ptr<const util::ZipArchive> archive;
+  size_t entry_idx{0};
+  uint64_t size{0};  // Size of the file or the uncompressed member
+
+  std::string GetName() const;
+
+  //
+  // Month of a daily file, which name starts with "YYYY-MM-DD"
+  //
+  std::optional<MonthIdx> GetMonth() const;
+
+  //
+  // Large CSV files are split between threads
+  //
+  bool IsLargeFile() const noexcept {
+    return !archive && size >= kLargeFileSize &&
+           file_path.extension() == ".csv";
+  }
 };
 
 //
+// Archive members are streamed through inflate without extracting them
+//
+void ReadRawStats(DataCenterStats& dc_stats,
+                  const RawStatsSource& source,
+                  const MonthRange& months);
+
 //
+// Large files are split between tasks of the pool
 //
 void ReadRawStats(DataCenterStats& dc_stats,
-                  const std::filesystem::path& file_path);
+                  const RawStatsSource& source,
+                  const MonthRange& months,
+                  util::ThreadPool& pool);
 
 //
+// Records are added by the producer of the calling thread of the pool; large
+// files are split between tasks of the pool
 //
+void ReadRawStats(ShardedStats& sharded_stats,
+                  const RawStatsSource& source,
+                  const MonthRange& months,
+                  util::ThreadPool& pool);
+
+//
+// .csv, .csv.gz or .csv.zst
+//
+bool IsRawStatsFile(const std::filesystem::path& file_path);
+
+//
+// CSV members of the zip archive
 //
-void ReadParsedStats(ModelStats& map, const std::filesystem::path& file_path);
+std::vector<RawStatsSource> ListArchiveSources(
+    const std::filesystem::path& file_path);
 
 //
+// Raw stats file itself or CSV members of a zip archive; other entries
+// have none
+//
+std::vector<RawStatsSource> ListRawStatsSources(
+    const std::filesystem::directory_entry& dir_entry);
+
+//
+// Yields entries of the input one by one; nothing at the end
+//
+using EntryGenerator =
+    std::function<std::optional<std::filesystem::directory_entry>()>;
+
 //
+// Sources are parsed by a pipeline of coroutines on the pool: discovery of
+// sources, reading them into blocks of complete records, parsing blocks and
+// aggregating records into stats of the threads which run the aggregators,
+// which are merged at the end. Stages are connected by bounded channels, so
+// reads overlap with parsing and the number of blocks in memory is limited
+//
+DataCenterStats ParseRawStats(const EntryGenerator& next_entry,
+                              const ParseOptions& options,
+                              util::ThreadPool& pool);
+
+//
+// Rows are formatted by tasks of the pool
 //
 void WriteParsedStats(const DataCenterStats& dc_stats,
-                      const std::filesystem::path& file_path);
+                      const std::filesystem::path& file_path,
+                      util::ThreadPool& pool);
+
+//
+// Shards of ShardedStats are written one after another
 //
+void WriteParsedStats(std::span<const DataCenterStats> shards,
+                      const std::filesystem::path& file_path,
+                      util::ThreadPool& pool);
+
 //
+// Both stats must share the dictionary
 //
 void MergeParsedStats(DataCenterStats& dc_stats,
                       const DataCenterStats& other_stats);
-}  // namespace bb
 
 //
+// Merges all other stats at once by tasks of the pool, which take ranges of
+// drive ids. Tasks don't allocate, so 'dc_stats' may use an arena
 //
-//
-template <std::input_iterator DirIt>
-bb::DataCenterStats ParseRawStats(DirIt it) {
-  const auto thread_count{std::thread::hardware_concurrency()};
+void MergeParsedStats(DataCenterStats& dc_stats,
+                      std::span<const DataCenterStats> other_stats,
+                      util::ThreadPool& pool);
 
-  std::mutex it_mutex;
-  const auto get_next_file_path{[&it_mutex, &it]() {
-    const std::scoped_lock lock{it_mutex};
+//
+// The stats with the most drives are moved into the result with their
+// arena, so only the others are merged into it. Stats must share the
+// dictionary; there must be at least one
+//
+DataCenterStats MergeParsedStats(std::vector<DataCenterStats>&& dc_stats,
+                                 util::ThreadPool& pool);
 
-    std::filesystem::path csv_path;
-    for (; it != DirIt{} && csv_path.empty(); ++it) {
-      const auto& dir_entry{*it};
+//
+// Rows of drive days of stats of later months are copied after the rows of
+// 'dc_stats' and failure dates are appended, so counters aren't added and
+// dates aren't merged. Stats with overlapping months are merged as usual
+//
+void SpliceParsedStats(DataCenterStats& dc_stats,
+                       const DataCenterStats& other_stats,
+                       util::ThreadPool& pool);
+}  // namespace bb
 
-      if (const auto& file_path = dir_entry.path();
-          file_path.extension() == ".csv") {
-        csv_path = file_path;
+//
+// Entries which can't be listed are reported and skipped
+//
+template <std::input_iterator DirIt, std::sentinel_for<DirIt> Sentinel>
+std::vector<bb::RawStatsSource> ListRawStatsSources(DirIt it,
+                                                    Sentinel last) {
+  std::vector<bb::RawStatsSource> sources;
+  while (it != last) {
+    try {
+      // Entries are copied before listing, so the iterator moves on even if
+      // an archive can't be opened
+      const std::filesystem::directory_entry dir_entry{*it};
+      ++it;
+      for (auto& source : bb::ListRawStatsSources(dir_entry)) {
+        sources.push_back(std::move(source));
       }
+
+    } catch (...) {
+      util::PrintException(std::current_exception());
     }
+  }
+  return sources;
+}
 
-    return csv_path;
-  }};
+//
+// Directory entries can be CSV files and zip archives, which are expanded into
+// their CSV members. Each source is parsed by a task of the pool, which
+// calls parse(source). Sources are submitted as the iterator yields them or,
+// in largest-first order, after all of them are listed
+//
+template <std::input_iterator DirIt,
+          std::sentinel_for<DirIt> Sentinel,
+          std::invocable<const bb::RawStatsSource&> ParseFn>
+void ParseRawStatsSources(DirIt it,
+                          Sentinel last,
+                          const bb::ParseOptions& options,
+                          util::ThreadPool& pool,
+                          ParseFn parse) {
+  std::vector<bb::RawStatsSource> sources;  // Only for largest-first order
+  std::atomic<size_t> started_count{0};
+
+  const auto parse_source{[&options, &sources, &started_count, &parse](
+                              const bb::RawStatsSource& source) noexcept {
+    try {
+      if (const auto number = ++started_count; options.largest_first) {
+        spdlog::info("Processing {} ({}/{})", source.GetName(), number,
+                     size(sources));
+      } else {
+        spdlog::info("Processing {}", source.GetName());
+      }
 
-  std::vector<bb::DataCenterStats> dc_stats(thread_count);
-  std::vector<std::thread> workers(thread_count);
+      parse(source);
 
-  for (size_t idx = 0; idx < thread_count; ++idx) {
-    workers[idx] = std::thread{[idx, &dc_stats, &get_next_file_path]() {
-      for (;;) {
-        try {
-          const std::filesystem::path file_path{get_next_file_path()};
-          if (file_path.empty()) {
-            break;
-          }
+    } catch (...) {
+      util::PrintException(std::current_exception());
+    }
+  }};
 
-          spdlog::info("Processing {}", file_path.string());
-          ReadRawStats(dc_stats[idx], file_path);
+  // Entries are copied before listing, so the iterator moves on even if
+  // an archive can't be opened
+  const auto list_next_entry{[&it]() {
+    const std::filesystem::directory_entry dir_entry{*it};
+    ++it;
+    return bb::ListRawStatsSources(dir_entry);
+  }};
 
-        } catch (...) {
-          util::PrintException(std::current_exception());
+  util::TaskGroup group{pool};
+  if (!options.largest_first) {
+    while (it != last) {
+      try {
+        for (auto& source : list_next_entry()) {
+          group.Run([&parse_source, source = std::move(source)] {
+            parse_source(source);
+          });
         }
+
+      } catch (...) {
+        util::PrintException(std::current_exception());
       }
-    }};
+    }
+  } else {
+    sources = ListRawStatsSources(std::move(it), std::move(last));
+    std::ranges::stable_sort(sources, std::ranges::greater{},
+                             &bb::RawStatsSource::size);
+
+    uint64_t total_size{0};
+    for (const auto& source : sources) {
+      total_size += source.size;
+    }
+    spdlog::info("Sources: {}, {} MiB", size(sources),
+                 total_size / (1024 * 1024));
+
+    // Tasks of this thread are taken from the front of its deque by all
+    // threads, so the largest go first
+    for (const auto& source : sources) {
+      group.Run([&parse_source, &source] { parse_source(source); });
+    }
   }
 
-  for (auto& worker : workers) {
-    worker.join();
+  group.Wait();
+}
+
+//
+// Sources are split into ranges of months of about equal sizes, a range per
+// thread. Each range is parsed in the order of dates by a task into stats of
+// its own, which are spliced at the end. Sources named by dates outside of
+// the months are skipped. Undated sources are parsed into stats which are
+// merged: small ones by a task each into stats of the thread, as they don't
+// wait inside the pool, and large ones, whose tasks wait for their chunks
+// and run other tasks meanwhile, one after another by a single task into
+// stats of its own
+//
+template <std::input_iterator DirIt, std::sentinel_for<DirIt> Sentinel>
+bb::DataCenterStats ParseDatedRawStats(DirIt it,
+                                       Sentinel last,
+                                       const bb::ParseOptions& options,
+                                       util::ThreadPool& pool) {
+  const auto sources{ListRawStatsSources(std::move(it), std::move(last))};
+
+  std::vector<std::pair<bb::MonthIdx, const bb::RawStatsSource*>> dated;
+  std::vector<const bb::RawStatsSource*> undated;
+  std::vector<const bb::RawStatsSource*> large_undated;
+  uint64_t dated_size{0};
+  for (const auto& source : sources) {
+    if (const auto month_idx = source.GetMonth(); !month_idx) {
+      (source.IsLargeFile() ? large_undated : undated).push_back(&source);
+    } else if (options.months.Contains(*month_idx)) {
+      dated.emplace_back(*month_idx, &source);
+      dated_size += source.size;
+    }
   }
+  std::ranges::stable_sort(dated, {}, [](const auto& dated_source) {
+    return dated_source.first;
+  });
+
+  // Ranges end at the first boundary of months after their share of size
+  const size_t thread_count{pool.GetThreadCount()};
+  std::vector<size_t> range_ends;  // Indexes in 'dated'
+  uint64_t range_size{0};
+  for (size_t idx = 0; idx < size(dated); ++idx) {
+    range_size += dated[idx].second->size;
+    if (idx + 1 == size(dated) ||
+        (dated[idx + 1].first != dated[idx].first &&
+         range_size * thread_count >= dated_size)) {
+      range_ends.push_back(idx + 1);
+      range_size = 0;
+    }
+  }
+  spdlog::info("Sources: {} in {} ranges of dates, {} undated", size(dated),
+               size(range_ends), size(undated) + size(large_undated));
+
+  // Stats of each range or thread are released at once with their arena.
+  // The last stats of threads are the ones of large undated sources
+  const auto dictionary{std::make_shared<bb::DriveDictionary>()};
+  const size_t undated_count{(undated.empty() ? 0 : thread_count) +
+                             (large_undated.empty() ? 0 : 1)};
+  std::vector<bb::DataCenterStats> range_stats;
+  std::vector<bb::DataCenterStats> thread_stats;
+  range_stats.reserve(size(range_ends));
+  thread_stats.reserve(undated_count);
+  for (size_t idx = 0; idx < size(range_ends); ++idx) {
+    range_stats.emplace_back(dictionary, std::make_shared<util::Arena>());
+  }
+  for (size_t idx = 0; idx < undated_count; ++idx) {
+    thread_stats.emplace_back(dictionary, std::make_shared<util::Arena>());
+  }
+
+  std::atomic<size_t> started_count{0};
+  const auto parse_source{[&options, &pool, &started_count,
+                           source_count = size(dated) + size(undated) +
+                                          size(large_undated)](
+                              bb::DataCenterStats& stats,
+                              const bb::RawStatsSource& source) noexcept {
+    try {
+      spdlog::info("Processing {} ({}/{})", source.GetName(),
+                   ++started_count, source_count);
+      ReadRawStats(stats, source, options.months, pool);
+
+    } catch (...) {
+      util::PrintException(std::current_exception());
+    }
+  }};
 
-  bb::DataCenterStats result;
-  for (auto& stats : dc_stats) {
-    MergeParsedStats(result, stats);
+  util::TaskGroup group{pool};
+  for (size_t range_idx = 0; range_idx < size(range_ends); ++range_idx) {
+    group.Run([&dated, &range_ends, &range_stats, &parse_source, range_idx] {
+      const size_t first{range_idx == 0 ? 0 : range_ends[range_idx - 1]};
+      for (size_t idx = first; idx < range_ends[range_idx]; ++idx) {
+        parse_source(range_stats[range_idx], *dated[idx].second);
+      }
+    });
+  }
+  for (const auto* source : undated) {
+    group.Run([&thread_stats, &parse_source, &pool, source] {
+      parse_source(thread_stats[pool.GetThreadIdx()], *source);
+    });
+  }
+  if (!large_undated.empty()) {
+    group.Run([&thread_stats, &large_undated, &parse_source] {
+      for (const auto* source : large_undated) {
+        parse_source(thread_stats.back(), *source);
+      }
+    });
   }
+  group.Wait();
 
+  // The first range is taken with its arena instead of being copied
+  if (range_stats.empty()) {
+    range_stats.emplace_back(dictionary);
+  }
+  bb::DataCenterStats result{std::move(range_stats.front())};
+  for (size_t idx = 1; idx < size(range_stats); ++idx) {
+    SpliceParsedStats(result, range_stats[idx], pool);
+  }
+  MergeParsedStats(result, thread_stats, pool);
   return result;
-}
\ No newline at end of file
+}
+
+//
+// Entries are parsed by the pipeline of bb::ParseRawStats, which takes them
+// from the iterator one by one
+//
+template <std::input_iterator DirIt, std::sentinel_for<DirIt> Sentinel = DirIt>
+bb::DataCenterStats ParseRawStats(DirIt it,
+                                  Sentinel last,
+                                  const bb::ParseOptions& options,
+                                  util::ThreadPool& pool) {
+  if (options.by_date) {
+    return ParseDatedRawStats(std::move(it), std::move(last), options, pool);
+  }
+
+  // Entries are copied before the iterator moves on
+  return bb::ParseRawStats(
+      [&it, &last]() -> std::optional<std::filesystem::directory_entry> {
+        if (it == last) {
+          return {};
+        }
+        std::filesystem::directory_entry dir_entry{*it};
+        ++it;
+        return dir_entry;
+      },
+      options, pool);
+}
+
+//
+// Threads of the pool produce records for shard threads, which aren't in
+// the pool, see ShardedStats::GetShardCount
+//
+template <std::input_iterator DirIt, std::sentinel_for<DirIt> Sentinel = DirIt>
+std::unique_ptr<bb::ShardedStats> ParseShardedRawStats(
+    DirIt it,
+    Sentinel last,
+    const bb::ParseOptions& options,
+    util::ThreadPool& pool,
+    size_t shard_count) {
+  auto sharded_stats{std::make_unique<bb::ShardedStats>(
+      std::make_shared<bb::DriveDictionary>(), shard_count,
+      pool.GetThreadCount())};
+
+  ParseRawStatsSources(
+      std::move(it), std::move(last), options, pool,
+      [&sharded_stats, &options, &pool](const bb::RawStatsSource& source) {
+        ReadRawStats(*sharded_stats, source, options.months, pool);
+      });
+
+  sharded_stats->Finish();
+  return sharded_stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace util {
+//
+// Buffers which are returned to the pool with their capacity when the last
+// reference to them is released, so their memory isn't allocated and
+// faulted in again. At most 'capacity' free buffers are kept; the number of
+// buffers in use is limited by their users. The pool must outlive them
+//
+class BufferPool {
+ public:
+  using Buffer = std::vector<char>;
+
+ public:
+  explicit BufferPool(size_t capacity) : m_capacity{capacity} {
+    m_buffers.reserve(capacity);  // Release() doesn't allocate
+  }
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  //
+  // Contents of a reused buffer are unspecified
+  //
+  std::shared_ptr<Buffer> Acquire() {
+    std::unique_ptr<Buffer> buffer;
+    {
+      const std::scoped_lock lock{m_mutex};
+      if (!m_buffers.empty()) {
+        buffer = std::move(m_buffers.back());
+        m_buffers.pop_back();
+      }
+    }
+
+    if (!buffer) {
+      buffer = std::make_unique<Buffer>();
+    }
+    return {buffer.release(), [this](Buffer* released) { Release(released); }};
+  }
+
+ private:
+  void Release(Buffer* released) noexcept {
+    std::unique_ptr<Buffer> buffer{released};
+    const std::scoped_lock lock{m_mutex};
+    if (std::size(m_buffers) < m_capacity) {
+      m_buffers.push_back(std::move(buffer));
+    }
+  }
+
+ private:
+  size_t m_capacity;
+
+  std::mutex m_mutex;
+  std::vector<std::unique_ptr<Buffer>> m_buffers;
+};
+}  // namespace util
@@ -0,0 +1,257 @@
+#pragma once
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace util {
+//
+// Coroutine which runs on a thread pool as a task of a TaskGroup. It starts
+// suspended and is resumed by tasks of the pool, so a wait in it doesn't
+// block any thread. The group waits for it to return and rethrows its
+// exception
+//
+class Job {
+ public:
+  struct promise_type;
+
+ private:
+  using Handle = std::coroutine_handle<promise_type>;
+
+  //
+  // The frame is destroyed before the group is notified, since the group
+  // may go away right after that
+  //
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(Handle handle) const noexcept {
+      TaskGroup& group{*handle.promise().group};
+      handle.destroy();
+      group.Finish();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+ public:
+  struct promise_type {
+    TaskGroup* group{nullptr};
+
+    Job get_return_object() noexcept {
+      return Job{Handle::from_promise(*this)};
+    }
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+
+    void unhandled_exception() const noexcept {
+      group->SetException(std::current_exception());
+    }
+  };
+
+ public:
+  Job(Job&& other) noexcept
+      : m_handle{std::exchange(other.m_handle, nullptr)} {}
+  Job& operator=(Job&&) = delete;
+
+  ~Job() {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+
+  //
+  // Runs the coroutine by a task of the group's pool
+  //
+  void Start(TaskGroup& group) && {
+    m_handle.promise().group = &group;
+    group.m_pending.fetch_add(1, std::memory_order_relaxed);
+    group.m_pool.Resume(std::exchange(m_handle, nullptr));
+  }
+
+  //
+  // Resumes the suspended coroutine by a task of its group's pool
+  //
+  static void Resume(std::coroutine_handle<promise_type> handle) {
+    handle.promise().group->m_pool.Resume(handle);
+  }
+
+ private:
+  explicit Job(Handle handle) noexcept : m_handle{handle} {}
+
+ private:
+  Handle m_handle;
+};
+
+//
+// Bounded queue between jobs: Push() waits while it's full and Pop() while
+// it's empty, so fast producers are held back. Waiters are resumed by tasks
+// of the pools of their jobs, so jobs of different pools may be connected.
+// Pop() yields nothing once the channel is closed and all values are taken.
+// Values pushed to a closed channel are dropped, so producers don't wait
+// for consumers which are gone
+//
+template <class Ty>
+class Channel {
+ public:
+  class PushAwaiter;
+  class PopAwaiter;
+
+ public:
+  explicit Channel(size_t capacity) noexcept
+      : m_capacity{std::max(capacity, size_t{1})} {}
+  Channel(const Channel&) = delete;
+  Channel& operator=(const Channel&) = delete;
+
+  [[nodiscard]] PushAwaiter Push(Ty value) {
+    return PushAwaiter{*this, std::move(value)};
+  }
+
+  [[nodiscard]] PopAwaiter Pop() noexcept { return PopAwaiter{*this}; }
+
+  //
+  // Waiting pushers are resumed and their values are dropped. Closing again
+  // does nothing
+  //
+  void Close() {
+    std::deque<PushAwaiter*> pushers;
+    std::deque<PopAwaiter*> poppers;
+    {
+      const std::scoped_lock lock{m_mutex};
+      m_closed = true;
+      pushers.swap(m_pushers);
+      poppers.swap(m_poppers);
+    }
+
+    for (auto* pusher : pushers) {
+      Job::Resume(pusher->m_handle);
+    }
+    for (auto* popper : poppers) {
+      Job::Resume(popper->m_handle);
+    }
+  }
+
+ private:
+  size_t m_capacity;
+
+  std::mutex m_mutex;
+  std::deque<Ty> m_values;
+  std::deque<PushAwaiter*> m_pushers;  // Wait while the channel is full
+  std::deque<PopAwaiter*> m_poppers;   // Wait while it's empty
+  bool m_closed{false};
+};
+
+//
+// A waiting popper takes the value directly. The awaiter is published under
+// the lock and isn't touched after that, since the coroutine may be resumed
+// by another thread at once
+//
+template <class Ty>
+class Channel<Ty>::PushAwaiter {
+ public:
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<Job::promise_type> handle) {
+    m_handle = handle;
+    auto& channel{m_channel};
+
+    std::unique_lock lock{channel.m_mutex};
+    if (channel.m_closed) {
+      return false;
+    }
+
+    if (!channel.m_poppers.empty()) {
+      PopAwaiter* const popper{channel.m_poppers.front()};
+      channel.m_poppers.pop_front();
+      popper->m_value = std::move(m_value);
+      lock.unlock();
+
+      Job::Resume(popper->m_handle);
+      return false;
+    }
+
+    if (std::size(channel.m_values) < channel.m_capacity) {
+      channel.m_values.push_back(std::move(m_value));
+      return false;
+    }
+
+    channel.m_pushers.push_back(this);
+    return true;
+  }
+
+  void await_resume() const noexcept {}
+
+ private:
+  friend class Channel;
+  friend class PopAwaiter;
+
+  PushAwaiter(Channel& channel, Ty value) noexcept(
+      std::is_nothrow_move_constructible_v<Ty>)
+      : m_channel{channel}, m_value{std::move(value)} {}
+
+ private:
+  Channel& m_channel;
+  Ty m_value;
+  std::coroutine_handle<Job::promise_type> m_handle;
+};
+
+//
+// Space freed by the popper is taken by the first waiting pusher
+//
+template <class Ty>
+class Channel<Ty>::PopAwaiter {
+ public:
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<Job::promise_type> handle) {
+    m_handle = handle;
+    auto& channel{m_channel};
+
+    std::unique_lock lock{channel.m_mutex};
+    if (!channel.m_values.empty()) {
+      m_value = std::move(channel.m_values.front());
+      channel.m_values.pop_front();
+
+      if (!channel.m_pushers.empty()) {
+        PushAwaiter* const pusher{channel.m_pushers.front()};
+        channel.m_pushers.pop_front();
+        channel.m_values.push_back(std::move(pusher->m_value));
+        lock.unlock();
+
+        Job::Resume(pusher->m_handle);
+      }
+      return false;
+    }
+
+    if (channel.m_closed) {
+      return false;
+    }
+
+    channel.m_poppers.push_back(this);
+    return true;
+  }
+
+  std::optional<Ty> await_resume() { return std::move(m_value); }
+
+ private:
+  friend class Channel;
+  friend class PushAwaiter;
+
+  explicit PopAwaiter(Channel& channel) noexcept : m_channel{channel} {}
+
+ private:
+  Channel& m_channel;
+  std::optional<Ty> m_value;
+  std::coroutine_handle<Job::promise_type> m_handle;
+};
+}  // namespace util
@@ -0,0 +1,217 @@
+#include "cpu.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+using namespace std;
+
+namespace util {
+#ifdef __linux__
+//
+// Quota of CPU time per period rounded up to whole CPUs; none if either
+// isn't positive, e.g. the quota is "max" or -1
+//
+static optional<size_t> GetQuotaCpuCount(int64_t quota, int64_t period) {
+  if (quota <= 0 || period <= 0) {
+    return {};
+  }
+  return static_cast<size_t>(max<int64_t>((quota + period - 1) / period, 1));
+}
+
+//
+// "<quota> <period>" or "max <period>"
+//
+static optional<size_t> ReadCgroupV2Limit(const filesystem::path& dir_path) {
+  ifstream file{dir_path / "cpu.max"};
+  int64_t quota{0};
+  int64_t period{0};
+  if (!(file >> quota >> period)) {
+    return {};
+  }
+  return GetQuotaCpuCount(quota, period);
+}
+
+//
+//
+//
+static optional<size_t> ReadCgroupV1Limit(const filesystem::path& dir_path) {
+  ifstream quota_file{dir_path / "cpu.cfs_quota_us"};
+  ifstream period_file{dir_path / "cpu.cfs_period_us"};
+  int64_t quota{0};
+  int64_t period{0};
+  if (!(quota_file >> quota) || !(period_file >> period)) {
+    return {};
+  }
+  return GetQuotaCpuCount(quota, period);
+}
+
+//
+// Parent cgroups limit their children, so the smallest limit on the way to
+// the root of the hierarchy is taken. Directories of cgroups outside of
+// the namespace of a container aren't mounted, so they are skipped
+//
+template <class ReadFn>
+static optional<size_t> GetCgroupLimit(const filesystem::path& mount_path,
+                                       filesystem::path cgroup_path,
+                                       ReadFn read_limit) {
+  optional<size_t> limit;
+  for (;;) {
+    if (const auto dir_limit =
+            read_limit(mount_path / cgroup_path.relative_path());
+        dir_limit && (!limit || *dir_limit < *limit)) {
+      limit = dir_limit;
+    }
+
+    if (cgroup_path == cgroup_path.parent_path()) {
+      break;
+    }
+    cgroup_path = cgroup_path.parent_path();
+  }
+  return limit;
+}
+
+//
+// Controllers are separated by commas, e.g. "cpu,cpuacct"
+//
+static bool HasController(string_view controllers, string_view name) {
+  while (!controllers.empty()) {
+    const size_t comma{controllers.find(',')};
+    if (controllers.substr(0, comma) == name) {
+      return true;
+    }
+    controllers.remove_prefix(comma == string_view::npos ? size(controllers)
+                                                         : comma + 1);
+  }
+  return false;
+}
+
+//
+// Lines of /proc/self/cgroup are "hierarchy-ID:controller-list:cgroup-path";
+// the list is empty for v2
+//
+static optional<size_t> GetCgroupCpuLimit() {
+  ifstream cgroups{"/proc/self/cgroup"};
+
+  optional<size_t> limit;
+  const auto update_limit{[&limit](optional<size_t> new_limit) {
+    if (new_limit && (!limit || *new_limit < *limit)) {
+      limit = new_limit;
+    }
+  }};
+
+  for (string line; getline(cgroups, line);) {
+    const size_t first_colon{line.find(':')};
+    if (first_colon == string::npos) {
+      continue;
+    }
+    const size_t second_colon{line.find(':', first_colon + 1)};
+    if (second_colon == string::npos) {
+      continue;
+    }
+
+    const string_view controllers{
+        string_view{line}.substr(first_colon + 1,
+                                 second_colon - first_colon - 1)};
+    const filesystem::path cgroup_path{line.substr(second_colon + 1)};
+    if (controllers.empty()) {
+      update_limit(
+          GetCgroupLimit("/sys/fs/cgroup", cgroup_path, ReadCgroupV2Limit));
+    } else if (HasController(controllers, "cpu")) {
+      for (const char* mount_path :
+           {"/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpu"}) {
+        update_limit(
+            GetCgroupLimit(mount_path, cgroup_path, ReadCgroupV1Limit));
+      }
+    }
+  }
+  return limit;
+}
+#endif
+
+//
+//
+//
+vector<size_t> GetAffinityCpus() {
+  vector<size_t> cpus;
+#ifdef _WIN32
+  // Only CPUs of the first processor group
+  DWORD_PTR process_mask{0};
+  DWORD_PTR system_mask{0};
+  if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask,
+                             &system_mask)) {
+    for (size_t cpu = 0; cpu < sizeof(process_mask) * 8; ++cpu) {
+      if ((process_mask >> cpu) & 1) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#elif defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+    for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpu_set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+
+//
+//
+//
+size_t GetAvailableCpuCount() {
+  size_t cpu_count{size(GetAffinityCpus())};
+  if (cpu_count == 0) {
+    cpu_count = thread::hardware_concurrency();
+  }
+
+#ifdef __linux__
+  if (const auto limit = GetCgroupCpuLimit(); limit && *limit < cpu_count) {
+    cpu_count = *limit;
+  }
+#endif
+  return max(cpu_count, size_t{1});
+}
+
+//
+//
+//
+bool PinThread(size_t cpu) noexcept {
+#ifdef _WIN32
+  if (cpu >= sizeof(DWORD_PTR) * 8) {
+    return false;
+  }
+  return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << cpu) != 0;
+#elif defined(__linux__)
+  if (cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set),
+                                &cpu_set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+}  // namespace util
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace util {
+//
+// CPUs the calling thread may run on by its affinity mask; empty if it
+// can't be read on this platform
+//
+std::vector<size_t> GetAffinityCpus();
+
+//
+// Number of CPUs the process may use: CPUs of the affinity mask, limited by
+// the CPU quota of its cgroup (v1 or v2) on Linux, e.g. in a container. At
+// least 1
+//
+size_t GetAvailableCpuCount();
+
+//
+// Binds the calling thread to the CPU, so memory first touched by it is
+// allocated on the NUMA node of the CPU. False if it isn't supported
+//
+bool PinThread(size_t cpu) noexcept;
+}  // namespace util
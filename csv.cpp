@@ -0,0 +1,388 @@
+#include "csv.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace csv {
+//
+//
+//
+static constexpr string_view kUtf8Bom{"\xEF\xBB\xBF"};
+
+//
+//
+//
+static constexpr bool IsLineBreak(char ch) noexcept {
+  return ch == '\n' || ch == '\r';
+}
+
+//
+//
+//
+Projection::Projection(const Fields& header, span<const string_view> names) {
+  m_columns.reserve(size(names));
+  for (size_t field_idx = 0; field_idx < size(names); ++field_idx) {
+    const auto& name{names[field_idx]};
+    const auto it{ranges::find(header, name)};
+    if (it == end(header)) {
+      throw out_of_range{fmt::format("Column not found: {}", name)};
+    }
+
+    m_columns.push_back(
+        {static_cast<size_t>(distance(begin(header), it)), field_idx});
+  }
+
+  ranges::sort(m_columns, {}, &Column::column_idx);
+}
+
+//
+//
+//
+bool Tokenizer::ReadRecord(Fields& fields) {
+  fields.clear();
+  if (!SkipEmptyLines()) {
+    return false;
+  }
+
+  size_t offset{m_offset};
+  for (;;) {
+    offset = ReadField(offset, &fields.emplace_back());
+    if (offset == size(m_data) || m_data[offset] != ',') {
+      break;
+    }
+
+    ++offset;
+  }
+
+  m_offset = offset;
+  return true;
+}
+
+//
+//
+//
+bool Tokenizer::ReadRecord(Fields& fields, const Projection& projection) {
+  fields.resize(projection.GetSize());
+  if (!SkipEmptyLines()) {
+    return false;
+  }
+
+  size_t offset{m_offset};
+  size_t column_idx{0};
+  for (const auto& column : projection.m_columns) {
+    for (; column_idx < column.column_idx; ++column_idx) {
+      offset = ReadField(offset, nullptr);
+      if (offset == size(m_data) || m_data[offset] != ',') {
+        throw out_of_range{
+            fmt::format("Column {} is missing: row has only {} fields",
+                        column.column_idx, column_idx + 1)};
+      }
+      ++offset;
+    }
+
+    offset = ReadField(offset, &fields[column.field_idx]);
+  }
+
+  m_offset = SkipRecord(offset);
+  return true;
+}
+
+//
+//
+//
+bool Tokenizer::SkipEmptyLines() noexcept {
+  while (m_offset < size(m_data) && IsLineBreak(m_data[m_offset])) {
+    ++m_offset;
+  }
+  return m_offset < size(m_data);
+}
+
+//
+// Returns offset of the separator or the line break after the field
+//
+size_t Tokenizer::ReadField(size_t offset, string_view* field) {
+  size_t first{offset};
+  size_t last;
+
+  if (offset < size(m_data) && m_data[offset] == '"') {
+    ++first;
+    last = SkipQuoted(offset) - 1;
+
+    // Garbage between the closing quote and the separator is ignored
+    offset = Find<&BlockMasks::separator, &BlockMasks::line_break>(last + 1);
+  } else {
+    last = Find<&BlockMasks::separator, &BlockMasks::line_break>(offset);
+    offset = last;
+  }
+
+  if (field) {
+    *field = m_data.substr(first, last - first);
+  }
+
+  return offset;
+}
+
+//
+// Returns offset past the closing quote
+//
+size_t Tokenizer::SkipQuoted(size_t offset) {
+  for (++offset;;) {
+    const size_t quote{Find<&BlockMasks::quote>(offset)};
+    if (quote == size(m_data)) {
+      throw invalid_argument{"Unterminated quoted field"};
+    }
+
+    if (quote + 1 < size(m_data) && m_data[quote + 1] == '"') {
+      offset = quote + 2;
+    } else {
+      return quote + 1;
+    }
+  }
+}
+
+//
+// Returns offset of the line break ending the record
+//
+size_t Tokenizer::SkipRecord(size_t offset) {
+  for (;;) {
+    offset = Find<&BlockMasks::quote, &BlockMasks::line_break>(offset);
+    if (offset == size(m_data) || m_data[offset] != '"') {
+      return offset;
+    }
+
+    offset = SkipQuoted(offset);
+  }
+}
+
+//
+//
+//
+size_t Tokenizer::FindRecordEnd(size_t offset, bool quoted) {
+  for (;;) {
+    offset = Find<&BlockMasks::quote, &BlockMasks::line_break>(offset);
+    if (offset == size(m_data)) {
+      return offset;
+    }
+
+    if (m_data[offset] == '"') {
+      quoted = !quoted;
+    } else if (!quoted) {
+      return offset;
+    }
+
+    ++offset;
+  }
+}
+
+//
+//
+//
+template <uint64_t BlockMasks::*... Masks>
+size_t Tokenizer::Find(size_t offset) {
+  const size_t data_size{size(m_data)};
+  while (offset < data_size) {
+    const size_t block_idx{offset / kBlockSize};
+    const auto& block_masks{GetBlockMasks(block_idx)};
+
+    const uint64_t mask{((block_masks.*Masks) | ...) >> offset % kBlockSize};
+    if (mask != 0) {
+      return offset + static_cast<size_t>(countr_zero(mask));
+    }
+
+    offset = (block_idx + 1) * kBlockSize;
+  }
+
+  return data_size;
+}
+
+//
+// Masks are built for the window of blocks starting at the requested one;
+// the trailing partial block is scanned through a zero-padded copy
+//
+const BlockMasks& Tokenizer::GetBlockMasks(size_t block_idx) {
+  if (block_idx < m_window_first_block ||
+      block_idx - m_window_first_block >= size(m_window)) {
+    const size_t data_size{size(m_data)};
+    const size_t block_count{(data_size + kBlockSize - 1) / kBlockSize};
+    const size_t window_size{min(kWindowBlockCount, block_count - block_idx)};
+    const size_t full_block_count{
+        min(window_size, data_size / kBlockSize - block_idx)};
+
+    m_window.resize(window_size);
+    m_window_first_block = block_idx;
+    ScanBlocks(data(m_data) + block_idx * kBlockSize, full_block_count,
+               data(m_window));
+
+    if (full_block_count < window_size) {
+      const size_t tail_offset{(block_idx + full_block_count) * kBlockSize};
+      char tail[kBlockSize]{};
+      memcpy(tail, data(m_data) + tail_offset, data_size - tail_offset);
+      ScanBlocks(tail, 1, &m_window[full_block_count]);
+    }
+  }
+
+  return m_window[block_idx - m_window_first_block];
+}
+
+//
+//
+//
+Reader::Reader(string_view data, span<const string_view> columns)
+    : m_tokenizer{MakeTokenizer(data)},
+      m_projection{MakeProjection(m_tokenizer, columns)} {}
+
+//
+//
+//
+Tokenizer Reader::MakeTokenizer(string_view data) noexcept {
+  if (data.starts_with(kUtf8Bom)) {
+    data.remove_prefix(size(kUtf8Bom));
+  }
+  return Tokenizer{data};
+}
+
+//
+//
+//
+Projection Reader::MakeProjection(Tokenizer& tokenizer,
+                                  span<const string_view> columns) {
+  Fields header;
+  if (!tokenizer.ReadRecord(header)) {
+    return {};  // Empty file
+  }
+  return {header, columns};
+}
+
+//
+//
+//
+static size_t GetEqualPartOffset(size_t data_size,
+                                 size_t part_count,
+                                 size_t part_idx) noexcept {
+  return static_cast<size_t>(static_cast<unsigned long long>(data_size) *
+                             part_idx / part_count);
+}
+
+//
+//
+//
+string_view GetEqualPart(string_view data,
+                         size_t part_count,
+                         size_t part_idx) noexcept {
+  const size_t first{GetEqualPartOffset(size(data), part_count, part_idx)};
+  const size_t last{GetEqualPartOffset(size(data), part_count, part_idx + 1)};
+  return data.substr(first, last - first);
+}
+
+//
+//
+//
+vector<string_view> SplitRecords(string_view records,
+                                 span<const size_t> quote_counts) {
+  const size_t part_count{size(quote_counts)};
+
+  vector<string_view> chunks;
+  chunks.reserve(part_count);
+
+  Tokenizer tokenizer{records};
+  size_t first{0};
+  bool quoted{false};
+
+  for (size_t part_idx = 1; part_idx < part_count; ++part_idx) {
+    quoted ^= quote_counts[part_idx - 1] % 2 != 0;
+
+    // A record may span the whole previous part; the quoting state is known
+    // to be clear at its end
+    const size_t part_first{
+        GetEqualPartOffset(size(records), part_count, part_idx)};
+    const size_t last{part_first > first
+                          ? tokenizer.FindRecordEnd(part_first, quoted)
+                          : tokenizer.FindRecordEnd(first, false)};
+
+    chunks.push_back(records.substr(first, last - first));
+    first = last;
+  }
+
+  chunks.push_back(records.substr(first));
+  return chunks;
+}
+
+//
+// A line break ends a record if the number of quotes before it is even
+//
+size_t FindCompleteRecords(string_view buffer) {
+  constexpr string_view kLineBreaks{"\r\n"};
+
+  size_t last{buffer.find_last_of(kLineBreaks)};
+  if (last == string_view::npos) {
+    return 0;
+  }
+
+  size_t quote_count{CountQuotes(buffer.substr(0, last))};
+  while (quote_count % 2 != 0) {
+    const size_t prev{last == 0 ? string_view::npos
+                                : buffer.find_last_of(kLineBreaks, last - 1)};
+    if (prev == string_view::npos) {
+      return 0;
+    }
+
+    quote_count -= CountQuotes(buffer.substr(prev, last - prev));
+    last = prev;
+  }
+
+  return last + 1;
+}
+
+//
+// Quotes inside quoted fields are doubled
+//
+void Writer::WriteField(string_view field) {
+  WriteSeparator();
+  if (field.find_first_of(", \"\r\n") == string_view::npos) {
+    m_buffer.append(field);
+    return;
+  }
+
+  m_buffer.push_back('"');
+  for (const char ch : field) {
+    if (ch == '"') {
+      m_buffer.push_back('"');
+    }
+    m_buffer.push_back(ch);
+  }
+  m_buffer.push_back('"');
+}
+
+//
+//
+//
+void Writer::WriteEmptyFields(size_t count) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    WriteSeparator();
+  }
+}
+
+//
+//
+//
+void Writer::EndRecord() {
+  m_buffer.append(kLineBreak);
+  m_first_field = true;
+}
+
+//
+//
+//
+void Writer::WriteSeparator() {
+  if (!m_first_field) {
+    m_buffer.push_back(',');
+  }
+  m_first_field = false;
+}
+}  // namespace csv
@@ -0,0 +1,197 @@
+#pragma once
+#include "csv_scan.hpp"
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace csv {
+//
+// Fields of a single record; views into the tokenized buffer
+//
+using Fields = std::vector<std::string_view>;
+
+//
+// Subset of columns resolved against the header once. Field i of a projected
+// record is the column names[i] of the source record
+//
+class Projection {
+ public:
+  Projection() noexcept = default;
+  Projection(const Fields& header, std::span<const std::string_view> names);
+
+  size_t GetSize() const noexcept { return size(m_columns); }
+
+ private:
+  friend class Tokenizer;
+
+  struct Column {
+    size_t column_idx;
+    size_t field_idx;
+  };
+
+  std::vector<Column> m_columns;  // Ordered by column_idx
+};
+
+//
+// Splits a memory buffer into records without copying anything.
+// Quoted fields are returned without the enclosing quotes, escaped quotes ("")
+// inside them are left as is. Empty lines are skipped.
+// Structural characters are located through the masks built by ScanBlocks()
+// for a sliding window of blocks
+//
+class Tokenizer {
+ public:
+  explicit Tokenizer(std::string_view data) noexcept : m_data{data} {}
+
+  bool ReadRecord(Fields& fields);
+
+  //
+  // Materializes only the projected columns and skips the rest of the record
+  // after the last of them
+  //
+  bool ReadRecord(Fields& fields, const Projection& projection);
+
+  //
+  // Offset of the first line break at or after 'offset' which isn't quoted,
+  // given the quoting state at 'offset'
+  //
+  size_t FindRecordEnd(size_t offset, bool quoted);
+
+  std::string_view GetUnread() const noexcept {
+    return m_data.substr(m_offset);
+  }
+
+ private:
+  static constexpr size_t kWindowBlockCount{256};
+
+  bool SkipEmptyLines() noexcept;
+  size_t ReadField(size_t offset, std::string_view* field);
+  size_t SkipQuoted(size_t offset);
+  size_t SkipRecord(size_t offset);
+
+  //
+  // Offset of the first character at or after 'offset' which is set in any
+  // of the masks, or the buffer size if there is no such one
+  //
+  template <uint64_t BlockMasks::*... Masks>
+  size_t Find(size_t offset);
+
+  const BlockMasks& GetBlockMasks(size_t block_idx);
+
+ private:
+  std::string_view m_data;
+  size_t m_offset{0};
+
+  std::vector<BlockMasks> m_window;
+  size_t m_window_first_block{0};
+};
+
+//
+// Tokenizer that yields the named columns of each row
+//
+class Reader {
+ public:
+  Reader(std::string_view data, std::span<const std::string_view> columns);
+
+  //
+  // Reads records without a header, e.g. a part of the file yielded
+  // by SplitRecords()
+  //
+  Reader(std::string_view records, Projection projection) noexcept
+      : m_tokenizer{records}, m_projection{std::move(projection)} {}
+
+  bool ReadRow() { return m_tokenizer.ReadRecord(m_row, m_projection); }
+
+  const Projection& GetProjection() const noexcept { return m_projection; }
+
+  std::string_view GetUnread() const noexcept {
+    return m_tokenizer.GetUnread();
+  }
+
+  //
+  // Field of the current row by its index in the 'columns' list
+  //
+  std::string_view GetCell(size_t idx) const noexcept { return m_row[idx]; }
+
+ private:
+  static Tokenizer MakeTokenizer(std::string_view data) noexcept;
+  static Projection MakeProjection(Tokenizer& tokenizer,
+                                   std::span<const std::string_view> columns);
+
+ private:
+  Tokenizer m_tokenizer;
+  Projection m_projection;
+  Fields m_row;
+};
+
+//
+// 'part_idx'-th of 'part_count' parts of nearly equal size
+//
+std::string_view GetEqualPart(std::string_view data,
+                              size_t part_count,
+                              size_t part_idx) noexcept;
+
+//
+// Splits records into size(quote_counts) ranges, moving each boundary of
+// GetEqualPart() to the end of the record it falls into. quote_counts[i] is
+// the number of quotes in the i-th part; boundaries inside quoted fields are
+// detected by its parity
+//
+std::vector<std::string_view> SplitRecords(
+    std::string_view records,
+    std::span<const size_t> quote_counts);
+
+//
+// Size of the longest prefix of the buffer which consists of complete records
+// or 0 if there are none. The buffer must begin at a record boundary
+//
+size_t FindCompleteRecords(std::string_view buffer);
+
+//
+// Line break of written records
+//
+#ifdef _WIN32
+inline constexpr std::string_view kLineBreak{"\r\n"};
+#else
+inline constexpr std::string_view kLineBreak{"\n"};
+#endif
+
+//
+// Appends records to a string, e.g. a part of the file formatted by one
+// thread
+//
+class Writer {
+ public:
+  explicit Writer(std::string& buffer) noexcept : m_buffer{buffer} {}
+
+  //
+  // Fields with separators, quotes, spaces or line breaks are quoted
+  //
+  void WriteField(std::string_view field);
+
+  template <std::integral Ty>
+  void WriteField(Ty value) {
+    char digits[24];
+    const auto [last, _]{std::to_chars(digits, digits + sizeof(digits), value)};
+    WriteSeparator();
+    m_buffer.append(digits, last);
+  }
+
+  void WriteEmptyFields(size_t count);
+
+  void EndRecord();
+
+ private:
+  void WriteSeparator();
+
+ private:
+  std::string& m_buffer;
+  bool m_first_field{true};
+};
+}  // namespace csv
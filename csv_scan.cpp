@@ -0,0 +1,267 @@
+#include "csv_scan.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define CSV_SCAN_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CSV_SCAN_TARGET(isa)
+#else
+#define CSV_SCAN_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+using namespace std;
+
+namespace csv {
+//
+//
+//
+using ScanFn = void (*)(const char*, size_t, BlockMasks*);
+
+//
+//
+//
+struct Scanner {
+  ScanFn fn;
+  string_view name;
+};
+
+//
+//
+//
+static void ScanBlocksScalar(const char* data,
+                             size_t block_count,
+                             BlockMasks* masks) {
+  for (size_t block_idx = 0; block_idx < block_count; ++block_idx) {
+    BlockMasks block_masks{};
+    for (size_t idx = 0; idx < kBlockSize; ++idx) {
+      const uint64_t bit{uint64_t{1} << idx};
+      switch (data[idx]) {
+        case ',':
+          block_masks.separator |= bit;
+          break;
+        case '"':
+          block_masks.quote |= bit;
+          break;
+        case '\n':
+        case '\r':
+          block_masks.line_break |= bit;
+          break;
+        default:
+          break;
+      }
+    }
+
+    masks[block_idx] = block_masks;
+    data += kBlockSize;
+  }
+}
+
+#ifdef CSV_SCAN_X86
+//
+//
+//
+CSV_SCAN_TARGET("sse2")
+static uint64_t MatchSse2(const __m128i (&chunks)[4], char ch) noexcept {
+  const __m128i pattern{_mm_set1_epi8(ch)};
+
+  uint64_t mask{0};
+  for (size_t idx = 0; idx < 4; ++idx) {
+    const auto bits{static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(chunks[idx], pattern)))};
+    mask |= static_cast<uint64_t>(bits) << (idx * 16);
+  }
+  return mask;
+}
+
+//
+//
+//
+CSV_SCAN_TARGET("sse2")
+static void ScanBlocksSse2(const char* data,
+                           size_t block_count,
+                           BlockMasks* masks) {
+  for (size_t block_idx = 0; block_idx < block_count; ++block_idx) {
+    const __m128i chunks[4]{
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48))};
+
+    masks[block_idx] = {
+        MatchSse2(chunks, ','), MatchSse2(chunks, '"'),
+        MatchSse2(chunks, '\n') | MatchSse2(chunks, '\r')};
+    data += kBlockSize;
+  }
+}
+
+//
+//
+//
+CSV_SCAN_TARGET("avx2")
+static uint64_t MatchAvx2(const __m256i (&chunks)[2], char ch) noexcept {
+  const __m256i pattern{_mm256_set1_epi8(ch)};
+  const auto low{static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunks[0], pattern)))};
+  const auto high{static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunks[1], pattern)))};
+  return static_cast<uint64_t>(high) << 32 | low;
+}
+
+//
+//
+//
+CSV_SCAN_TARGET("avx2")
+static void ScanBlocksAvx2(const char* data,
+                           size_t block_count,
+                           BlockMasks* masks) {
+  for (size_t block_idx = 0; block_idx < block_count; ++block_idx) {
+    const __m256i chunks[2]{
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32))};
+
+    masks[block_idx] = {
+        MatchAvx2(chunks, ','), MatchAvx2(chunks, '"'),
+        MatchAvx2(chunks, '\n') | MatchAvx2(chunks, '\r')};
+    data += kBlockSize;
+  }
+}
+
+//
+//
+//
+CSV_SCAN_TARGET("avx512f,avx512bw")
+static void ScanBlocksAvx512(const char* data,
+                             size_t block_count,
+                             BlockMasks* masks) {
+  const __m512i separator{_mm512_set1_epi8(',')};
+  const __m512i quote{_mm512_set1_epi8('"')};
+  const __m512i line_feed{_mm512_set1_epi8('\n')};
+  const __m512i carriage_return{_mm512_set1_epi8('\r')};
+
+  for (size_t block_idx = 0; block_idx < block_count; ++block_idx) {
+    const __m512i chunk{_mm512_loadu_si512(data)};
+    masks[block_idx] = {_mm512_cmpeq_epi8_mask(chunk, separator),
+                        _mm512_cmpeq_epi8_mask(chunk, quote),
+                        _mm512_cmpeq_epi8_mask(chunk, line_feed) |
+                            _mm512_cmpeq_epi8_mask(chunk, carriage_return)};
+    data += kBlockSize;
+  }
+}
+
+//
+//
+//
+struct CpuFeatures {
+  bool sse2;
+  bool avx2;
+  bool avx512bw;
+};
+
+//
+//
+//
+static CpuFeatures GetCpuFeatures() noexcept {
+#ifdef _MSC_VER
+  int regs[4];
+  __cpuid(regs, 0);
+  const int max_leaf{regs[0]};
+
+  __cpuid(regs, 1);
+  const bool sse2{(regs[3] & (1 << 26)) != 0};
+  const bool os_xsave{(regs[2] & (1 << 27)) != 0};
+  if (!os_xsave || max_leaf < 7) {
+    return {sse2, false, false};
+  }
+
+  // The OS must preserve YMM (and ZMM for AVX-512) state on context switches
+  const auto xcr0{_xgetbv(0)};
+  const bool os_avx{(xcr0 & 0x6) == 0x6};
+  const bool os_avx512{(xcr0 & 0xE6) == 0xE6};
+
+  __cpuidex(regs, 7, 0);
+  const bool avx2{os_avx && (regs[1] & (1 << 5)) != 0};
+  const bool avx512bw{os_avx512 && (regs[1] & (1 << 16)) != 0 &&
+                      (regs[1] & (1 << 30)) != 0};
+  return {sse2, avx2, avx512bw};
+#else
+  __builtin_cpu_init();
+  return {__builtin_cpu_supports("sse2") != 0,
+          __builtin_cpu_supports("avx2") != 0,
+          __builtin_cpu_supports("avx512f") != 0 &&
+              __builtin_cpu_supports("avx512bw") != 0};
+#endif
+}
+#endif
+
+//
+//
+//
+static Scanner SelectScanner() noexcept {
+#ifdef CSV_SCAN_X86
+  if (const auto features = GetCpuFeatures(); features.avx512bw) {
+    return {ScanBlocksAvx512, "AVX-512"};
+  } else if (features.avx2) {
+    return {ScanBlocksAvx2, "AVX2"};
+  } else if (features.sse2) {
+    return {ScanBlocksSse2, "SSE2"};
+  }
+#endif
+  return {ScanBlocksScalar, "scalar"};
+}
+
+//
+//
+//
+static const Scanner& GetScanner() noexcept {
+  static const Scanner scanner{SelectScanner()};
+  return scanner;
+}
+
+//
+//
+//
+void ScanBlocks(const char* data, size_t block_count, BlockMasks* masks) {
+  GetScanner().fn(data, block_count, masks);
+}
+
+//
+//
+//
+size_t CountQuotes(string_view buffer) {
+  array<BlockMasks, 256> masks;
+
+  size_t quote_count{0};
+  while (size(buffer) >= kBlockSize) {
+    const size_t block_count{min(size(masks), size(buffer) / kBlockSize)};
+    ScanBlocks(data(buffer), block_count, data(masks));
+    for (size_t idx = 0; idx < block_count; ++idx) {
+      quote_count += static_cast<size_t>(popcount(masks[idx].quote));
+    }
+    buffer.remove_prefix(block_count * kBlockSize);
+  }
+
+  if (!buffer.empty()) {
+    char tail[kBlockSize]{};
+    memcpy(tail, data(buffer), size(buffer));
+    ScanBlocks(tail, 1, data(masks));
+    quote_count += static_cast<size_t>(popcount(masks[0].quote));
+  }
+
+  return quote_count;
+}
+
+//
+//
+//
+string_view GetScannerName() {
+  return GetScanner().name;
+}
+}  // namespace csv
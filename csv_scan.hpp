@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace csv {
+//
+// Input is scanned by blocks of 64 bytes, one mask bit per byte
+//
+inline constexpr size_t kBlockSize{64};
+
+//
+// Positions of structural characters in a block
+//
+struct BlockMasks {
+  uint64_t separator;   // ','
+  uint64_t quote;       // '"'
+  uint64_t line_break;  // '\n' and '\r'
+};
+
+//
+// Builds masks of 'block_count' full blocks starting at 'data'.
+// The kernel (AVX-512, AVX2, SSE2 or scalar) is chosen by the CPU features
+// on the first call
+//
+void ScanBlocks(const char* data, size_t block_count, BlockMasks* masks);
+
+//
+// Number of quotes in the buffer
+//
+size_t CountQuotes(std::string_view data);
+
+//
+// Instruction set of the kernel used by ScanBlocks()
+//
+std::string_view GetScannerName();
+}  // namespace csv
@@ -0,0 +1,158 @@
+#include "drive_dictionary.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace bb {
+//
+//
+//
+static constexpr uint32_t kEmptySlot{0};
+static constexpr uint32_t kBusySlot{1};
+static constexpr uint32_t kFirstIdSlot{2};
+
+//
+//
+//
+SerialKey::SerialKey(string_view serial_number) noexcept
+    : m_hash{ankerl::unordered_dense::hash<string_view>{}(serial_number)},
+      m_size{static_cast<uint8_t>(size(serial_number))} {
+  ranges::copy(serial_number, begin(m_data));
+}
+
+//
+// Slots are zeroed by the OS
+//
+DriveDictionary::DriveDictionary(size_t capacity)
+    : m_capacity{bit_ceil(max(capacity, size_t{2}))},
+      m_slots{static_cast<uint32_t*>(
+          m_pages.allocate(m_capacity * sizeof(uint32_t)))},
+      m_entries{static_cast<Entry*>(
+          m_pages.allocate(m_capacity * sizeof(Entry)))} {}
+
+//
+//
+//
+DriveDictionary::~DriveDictionary() {
+  m_pages.deallocate(m_entries, m_capacity * sizeof(Entry));
+  m_pages.deallocate(m_slots, m_capacity * sizeof(uint32_t));
+}
+
+//
+//
+//
+ModelId DriveDictionary::AddModel(string_view model_name) {
+  const scoped_lock lock{m_mutex};
+  return m_model_names.Intern(model_name);
+}
+
+//
+//
+//
+string_view DriveDictionary::GetModelName(ModelId model_id) const {
+  const scoped_lock lock{m_mutex};
+  return m_model_names.GetString(model_id);
+}
+
+//
+//
+//
+DriveId DriveDictionary::AddDrive(ModelId model_id, string_view serial_number) {
+  if (size(serial_number) > SerialKey::kCapacity) {
+    return AddLongDrive(model_id, serial_number);
+  }
+  return AddDrive(model_id, SerialKey{serial_number});
+}
+
+//
+//
+//
+string_view DriveDictionary::GetSerialNumber(DriveId drive_id) const {
+  const auto& entry{m_entries[drive_id]};
+  if (entry.long_serial_idx == kShortSerial) {
+    return entry.serial.GetView();
+  }
+
+  const scoped_lock lock{m_mutex};
+  return m_long_serials[entry.long_serial_idx];
+}
+
+//
+// Linear probing; the table is filled by half at most
+//
+DriveId DriveDictionary::AddDrive(ModelId model_id, const SerialKey& serial) {
+  const size_t mask{m_capacity - 1};
+  const uint64_t hash{serial.GetHash() ^
+                      (model_id * uint64_t{0x9E3779B97F4A7C15})};
+
+  for (size_t slot_idx = hash & mask;; slot_idx = (slot_idx + 1) & mask) {
+    atomic_ref<uint32_t> slot{m_slots[slot_idx]};
+
+    uint32_t state{slot.load(memory_order_acquire)};
+    if (state == kEmptySlot) {
+      if (GetDriveCount() >= m_capacity / 2) {
+        throw length_error{"Too many drives"};
+      }
+
+      if (slot.compare_exchange_strong(state, kBusySlot,
+                                       memory_order_acquire)) {
+        const auto drive_id{PublishEntry({model_id, kShortSerial, serial})};
+        slot.store(drive_id + kFirstIdSlot, memory_order_release);
+        return drive_id;
+      }
+    }
+
+    // Another thread is writing the entry
+    while (state == kBusySlot) {
+      this_thread::yield();
+      state = slot.load(memory_order_acquire);
+    }
+
+    const DriveId drive_id{state - kFirstIdSlot};
+    if (const auto& entry = m_entries[drive_id];
+        entry.model_id == model_id && entry.serial == serial) {
+      return drive_id;
+    }
+  }
+}
+
+//
+//
+//
+DriveId DriveDictionary::AddLongDrive(ModelId model_id,
+                                      string_view serial_number) {
+  const scoped_lock lock{m_mutex};
+
+  auto key{fmt::format("{}/{}", model_id, serial_number)};
+  if (const auto it = m_long_ids.find(key); it != end(m_long_ids)) {
+    return it->second;
+  }
+
+  if (GetDriveCount() >= m_capacity / 2) {
+    throw length_error{"Too many drives"};
+  }
+
+  const auto long_serial_idx{static_cast<uint32_t>(size(m_long_serials))};
+  m_long_serials.emplace_back(serial_number);
+
+  const auto drive_id{PublishEntry({model_id, long_serial_idx, {}})};
+  m_long_ids.emplace(std::move(key), drive_id);
+  return drive_id;
+}
+
+//
+// Entries of ids which are in use are never rewritten
+//
+DriveId DriveDictionary::PublishEntry(const Entry& entry) {
+  const auto drive_id{m_drive_count.fetch_add(1, memory_order_acq_rel)};
+  construct_at(m_entries + drive_id, entry);
+  return drive_id;
+}
+}  // namespace bb
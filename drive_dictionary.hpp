@@ -0,0 +1,118 @@
+#pragma once
+#include "unordered_dense/include/ankerl/unordered_dense.h"
+#include "arena.hpp"
+#include "interner.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace bb {
+//
+// Index of the model name in DriveDictionary
+//
+using ModelId = uint32_t;
+
+//
+// Dense index of a drive, i.e. a pair of a model and a serial number
+//
+using DriveId = uint32_t;
+
+//
+// Serial number stored inline together with its hash, which is computed
+// once when the key is made
+//
+class SerialKey {
+ public:
+  static constexpr size_t kCapacity{23};
+
+ public:
+  SerialKey() noexcept = default;
+
+  //
+  // Serial number must fit into kCapacity
+  //
+  explicit SerialKey(std::string_view serial_number) noexcept;
+
+  std::string_view GetView() const noexcept { return {data(m_data), m_size}; }
+
+  uint64_t GetHash() const noexcept { return m_hash; }
+
+  bool operator==(const SerialKey& other) const noexcept = default;
+
+ private:
+  uint64_t m_hash{0};  // Compared first
+  uint8_t m_size{0};
+  std::array<char, kCapacity> m_data{};
+};
+
+//
+// Ids of models and drives shared by all threads. Drives are found in an
+// open addressing table of fixed capacity without locks: a thread claims an
+// empty slot by CAS, writes the entry and then publishes its id, while other
+// threads looking for the same drive wait for the id. Serial numbers longer
+// than SerialKey::kCapacity and model names, which are few, are guarded by
+// a mutex
+//
+class DriveDictionary {
+ public:
+  static constexpr size_t kDefaultCapacity{size_t{1} << 22};
+
+ public:
+  //
+  // Capacity is rounded up to a power of 2, and the table holds up to half
+  // of it to keep probes short. Pages are committed by the OS on first touch
+  //
+  explicit DriveDictionary(size_t capacity = kDefaultCapacity);
+  DriveDictionary(const DriveDictionary&) = delete;
+  DriveDictionary& operator=(const DriveDictionary&) = delete;
+  ~DriveDictionary();
+
+  ModelId AddModel(std::string_view model_name);
+
+  std::string_view GetModelName(ModelId model_id) const;
+
+  DriveId AddDrive(ModelId model_id, std::string_view serial_number);
+
+  ModelId GetModel(DriveId drive_id) const noexcept {
+    return m_entries[drive_id].model_id;
+  }
+
+  std::string_view GetSerialNumber(DriveId drive_id) const;
+
+  size_t GetDriveCount() const noexcept {
+    return m_drive_count.load(std::memory_order_acquire);
+  }
+
+ private:
+  struct Entry {
+    ModelId model_id;
+    uint32_t long_serial_idx;  // kShortSerial if the key holds the serial
+    SerialKey serial;
+  };
+
+  static constexpr uint32_t kShortSerial{UINT32_MAX};
+
+ private:
+  DriveId AddDrive(ModelId model_id, const SerialKey& serial);
+  DriveId AddLongDrive(ModelId model_id, std::string_view serial_number);
+  DriveId PublishEntry(const Entry& entry);
+
+ private:
+  util::PageResource m_pages{false};
+  size_t m_capacity;
+  uint32_t* m_slots;  // 0 - empty, 1 - being written, id + 2 - ready
+  Entry* m_entries;
+  std::atomic<uint32_t> m_drive_count{0};
+
+  mutable std::mutex m_mutex;
+  util::Interner m_model_names;
+  ankerl::unordered_dense::map<std::string, DriveId> m_long_ids;
+  std::deque<std::string> m_long_serials;
+};
+}  // namespace bb
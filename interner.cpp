@@ -0,0 +1,50 @@
+#include "interner.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace util {
+//
+// Strings are packed into chunks of this size; longer ones get their own
+//
+static constexpr size_t kChunkSize{64 * 1024};
+
+//
+//
+//
+Interner::Id Interner::Intern(string_view str) {
+  if (const auto it = m_ids.find(str); it != end(m_ids)) {
+    return it->second;
+  }
+
+  if (size(m_ids) > numeric_limits<Id>::max()) {
+    throw length_error{"Too many interned strings"};
+  }
+
+  const auto id{static_cast<Id>(size(m_ids))};
+  m_ids.emplace(Store(str), id);
+  return id;
+}
+
+//
+//
+//
+string_view Interner::Store(string_view str) {
+  if (str.empty()) {
+    return {};
+  }
+
+  if (m_chunks.empty() ||
+      size(str) > m_chunks.back().capacity() - size(m_chunks.back())) {
+    m_chunks.emplace_back().reserve(max(size(str), kChunkSize));
+  }
+
+  auto& chunk{m_chunks.back()};
+  const size_t offset{size(chunk)};
+  chunk.insert(end(chunk), begin(str), end(str));
+  return {data(chunk) + offset, size(str)};
+}
+}  // namespace util
@@ -0,0 +1,39 @@
+#pragma once
+#include "unordered_dense/include/ankerl/unordered_dense.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace util {
+//
+// Maps strings to dense ids starting from 0. Each distinct string is copied
+// once into chunked storage, which keeps its address on moves
+//
+class Interner {
+ public:
+  using Id = uint32_t;
+
+ public:
+  explicit Interner(std::pmr::memory_resource* resource =
+                        std::pmr::get_default_resource())
+      : m_ids{resource}, m_chunks{resource} {}
+
+  Id Intern(std::string_view str);
+
+  std::string_view GetString(Id id) const noexcept {
+    return m_ids.values()[id].first;
+  }
+
+  size_t GetSize() const noexcept { return size(m_ids); }
+
+ private:
+  std::string_view Store(std::string_view str);
+
+ private:
+  ankerl::unordered_dense::pmr::map<std::string_view, Id> m_ids;
+  std::pmr::vector<std::pmr::vector<char>> m_chunks;
+};
+}  // namespace util
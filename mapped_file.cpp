@@ -0,0 +1,314 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <limits>
+#include <system_error>
+#include <utility>
+
+using namespace std;
+
+namespace util {
+//
+// Smallest page size of supported platforms
+//
+static constexpr size_t kPageSize{4096};
+
+#ifdef _WIN32
+//
+//
+//
+class Handle {
+ public:
+  explicit Handle(HANDLE handle) noexcept : m_handle{handle} {}
+  Handle(const Handle&) = delete;
+  Handle& operator=(const Handle&) = delete;
+  ~Handle() {
+    if (m_handle && m_handle != INVALID_HANDLE_VALUE) {
+      CloseHandle(m_handle);
+    }
+  }
+
+  HANDLE Get() const noexcept { return m_handle; }
+
+ private:
+  HANDLE m_handle;
+};
+
+//
+//
+//
+[[noreturn]] static void ThrowLastError(const char* what) {
+  throw system_error{static_cast<int>(GetLastError()), system_category(),
+                     what};
+}
+
+//
+//
+//
+MappedFile::MappedFile(const filesystem::path& file_path) {
+  const Handle file{CreateFileW(file_path.c_str(), GENERIC_READ,
+                                FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_FLAG_SEQUENTIAL_SCAN, nullptr)};
+  if (file.Get() == INVALID_HANDLE_VALUE) {
+    ThrowLastError("CreateFileW");
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file.Get(), &file_size)) {
+    ThrowLastError("GetFileSizeEx");
+  }
+
+  if (file_size.QuadPart == 0) {
+    return;
+  }
+
+  const Handle mapping{CreateFileMappingW(file.Get(), nullptr, PAGE_READONLY,
+                                          0, 0, nullptr)};
+  if (!mapping.Get()) {
+    ThrowLastError("CreateFileMappingW");
+  }
+
+  const auto* data{MapViewOfFile(mapping.Get(), FILE_MAP_READ, 0, 0, 0)};
+  if (!data) {
+    ThrowLastError("MapViewOfFile");
+  }
+
+  m_data = static_cast<const char*>(data);
+  m_size = static_cast<size_t>(file_size.QuadPart);
+}
+
+//
+//
+//
+void MappedFile::Reset() noexcept {
+  if (m_data) {
+    UnmapViewOfFile(m_data);
+  }
+}
+
+//
+//
+//
+FileStream::FileStream(const filesystem::path& file_path)
+    : m_handle{CreateFileW(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                           nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                           nullptr)} {
+  if (m_handle == INVALID_HANDLE_VALUE) {
+    ThrowLastError("CreateFileW");
+  }
+}
+
+//
+//
+//
+FileStream::~FileStream() {
+  CloseHandle(m_handle);
+}
+
+//
+// ReadFile() takes at most 4 GiB at once
+//
+size_t FileStream::Read(span<char> buffer) {
+  size_t read_size{0};
+  while (read_size < size(buffer)) {
+    const auto request_size{static_cast<DWORD>(min<size_t>(
+        size(buffer) - read_size, numeric_limits<DWORD>::max()))};
+    DWORD chunk_size{0};
+    if (!ReadFile(m_handle, data(buffer) + read_size, request_size,
+                  &chunk_size, nullptr)) {
+      ThrowLastError("ReadFile");
+    }
+    if (chunk_size == 0) {
+      break;
+    }
+    read_size += chunk_size;
+  }
+  return read_size;
+}
+#else
+//
+//
+//
+class Descriptor {
+ public:
+  explicit Descriptor(int fd) noexcept : m_fd{fd} {}
+  Descriptor(const Descriptor&) = delete;
+  Descriptor& operator=(const Descriptor&) = delete;
+  ~Descriptor() {
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+  }
+
+  int Get() const noexcept { return m_fd; }
+
+ private:
+  int m_fd;
+};
+
+//
+//
+//
+[[noreturn]] static void ThrowLastError(const char* what) {
+  throw system_error{errno, system_category(), what};
+}
+
+//
+//
+//
+MappedFile::MappedFile(const filesystem::path& file_path) {
+  const Descriptor file{open(file_path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (file.Get() < 0) {
+    ThrowLastError("open");
+  }
+
+  struct stat file_stat {};
+  if (fstat(file.Get(), &file_stat) != 0) {
+    ThrowLastError("fstat");
+  }
+
+  if (file_stat.st_size == 0) {
+    return;
+  }
+
+  const auto file_size{static_cast<size_t>(file_stat.st_size)};
+  void* data{mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, file.Get(), 0)};
+  if (data == MAP_FAILED) {
+    ThrowLastError("mmap");
+  }
+
+  // The hint is advisory, so failure isn't an error
+  madvise(data, file_size, MADV_SEQUENTIAL);
+
+  m_data = static_cast<const char*>(data);
+  m_size = file_size;
+}
+
+//
+//
+//
+void MappedFile::Reset() noexcept {
+  if (m_data) {
+    munmap(const_cast<char*>(m_data), m_size);
+  }
+}
+
+//
+//
+//
+FileStream::FileStream(const filesystem::path& file_path)
+    : m_fd{open(file_path.c_str(), O_RDONLY | O_CLOEXEC)} {
+  if (m_fd < 0) {
+    ThrowLastError("open");
+  }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  // Hints are advisory, so failures aren't errors
+  posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+//
+//
+//
+FileStream::~FileStream() {
+  close(m_fd);
+}
+
+//
+// A short read doesn't mean the end of the file, so reads are repeated
+// until the buffer is full or nothing is read
+//
+size_t FileStream::Read(span<char> buffer) {
+  size_t read_size{0};
+  while (read_size < size(buffer)) {
+    const ssize_t chunk_size{
+        read(m_fd, data(buffer) + read_size, size(buffer) - read_size)};
+    if (chunk_size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ThrowLastError("read");
+    }
+    if (chunk_size == 0) {
+      break;
+    }
+    read_size += static_cast<size_t>(chunk_size);
+  }
+
+  m_offset += read_size;
+#ifdef POSIX_FADV_WILLNEED
+  if (read_size != 0) {
+    posix_fadvise(m_fd, static_cast<off_t>(m_offset),
+                  static_cast<off_t>(size(buffer)), POSIX_FADV_WILLNEED);
+  }
+#endif
+  return read_size;
+}
+#endif
+
+//
+// The OS is asked for the whole range first, so it's read by large requests
+// instead of by page faults one after another
+//
+void PrefetchPages(string_view data) noexcept {
+  if (data.empty()) {
+    return;
+  }
+
+#ifndef _WIN32
+  const auto first{reinterpret_cast<uintptr_t>(std::data(data)) &
+                   ~uintptr_t{kPageSize - 1}};
+  const auto last{reinterpret_cast<uintptr_t>(std::data(data)) +
+                  std::size(data)};
+  madvise(reinterpret_cast<void*>(first), last - first, MADV_WILLNEED);
+#endif
+
+  // One byte of each page; volatile, so the reads aren't optimized away
+  const volatile char* const bytes{std::data(data)};
+  char sum{0};
+  for (size_t offset = 0; offset < std::size(data); offset += kPageSize) {
+    sum += bytes[offset];
+  }
+  (void)sum;
+}
+
+//
+//
+//
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data{exchange(other.m_data, nullptr)},
+      m_size{exchange(other.m_size, 0)} {}
+
+//
+//
+//
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    Reset();
+    m_data = exchange(other.m_data, nullptr);
+    m_size = exchange(other.m_size, 0);
+  }
+  return *this;
+}
+
+//
+//
+//
+MappedFile::~MappedFile() {
+  Reset();
+}
+}  // namespace util
@@ -0,0 +1,63 @@
+#pragma once
+#include "stream.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+namespace util {
+//
+// Read-only view of a whole file mapped into memory
+//
+class MappedFile {
+ public:
+  MappedFile() noexcept = default;
+  explicit MappedFile(const std::filesystem::path& file_path);
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  ~MappedFile();
+
+  std::string_view GetView() const noexcept { return {m_data, m_size}; }
+  size_t GetSize() const noexcept { return m_size; }
+
+ private:
+  void Reset() noexcept;
+
+ private:
+  const char* m_data{nullptr};
+  size_t m_size{0};
+};
+
+//
+// Reads pages of mapped data, so their page faults are taken by the
+// calling thread instead of by the one which uses the data later
+//
+void PrefetchPages(std::string_view data) noexcept;
+
+//
+// File read by system calls into the caller's buffers. The OS is told that
+// the file is read sequentially, and the range of the next read is
+// requested after each one, so it's fetched while the data is processed
+//
+class FileStream : public InputStream {
+ public:
+  explicit FileStream(const std::filesystem::path& file_path);
+  FileStream(const FileStream&) = delete;
+  FileStream& operator=(const FileStream&) = delete;
+  ~FileStream() override;
+
+  size_t Read(std::span<char> buffer) override;
+
+ private:
+#ifdef _WIN32
+  void* m_handle;
+#else
+  int m_fd;
+  uint64_t m_offset{0};
+#endif
+};
+}  // namespace util
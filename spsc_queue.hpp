@@ -0,0 +1,53 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <utility>
+
+namespace util {
+//
+// Indexes written by different threads are kept on separate cache lines
+//
+inline constexpr size_t kCacheLineSize{64};
+
+//
+// Bounded lock-free queue of a single producer and a single consumer.
+// Indexes only grow and select slots modulo the capacity
+//
+template <class Ty, size_t Capacity>
+class SpscQueue {
+  static_assert(std::has_single_bit(Capacity), "Capacity must be 2^N");
+
+ public:
+  //
+  // The value is moved from only if the queue isn't full
+  //
+  bool TryPush(Ty& value) {
+    const size_t tail{m_tail.load(std::memory_order_relaxed)};
+    if (tail - m_head.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+
+    m_slots[tail % Capacity] = std::move(value);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(Ty& value) {
+    const size_t head{m_head.load(std::memory_order_relaxed)};
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    value = std::move(m_slots[head % Capacity]);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  std::array<Ty, Capacity> m_slots{};
+  alignas(kCacheLineSize) std::atomic<size_t> m_head{0};  // Consumer's
+  alignas(kCacheLineSize) std::atomic<size_t> m_tail{0};  // Producer's
+};
+}  // namespace util
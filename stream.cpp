@@ -0,0 +1,190 @@
+#include "stream.hpp"
+
+#include <fmt/format.h>
+#ifdef BACKBLAZE_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+
+using namespace std;
+
+namespace util {
+//
+//
+//
+size_t MemoryStream::Read(span<char> buffer) {
+  const size_t read_size{min(size(buffer), size(m_data))};
+  memcpy(data(buffer), data(m_data), read_size);
+  m_data.remove_prefix(read_size);
+  return read_size;
+}
+
+//
+//
+//
+InflateStream::InflateStream(string_view compressed, Format format)
+    : m_compressed{compressed}, m_format{format} {
+  const int window_bits{format == Format::kGzip ? 16 + MAX_WBITS : -MAX_WBITS};
+  if (const int code = inflateInit2(&m_stream, window_bits); code != Z_OK) {
+    ThrowError(code);
+  }
+}
+
+//
+//
+//
+InflateStream::~InflateStream() {
+  inflateEnd(&m_stream);
+}
+
+//
+//
+//
+size_t InflateStream::Read(span<char> buffer) {
+  size_t read_size{0};
+  while (read_size < size(buffer) && !m_finished) {
+    FeedInput();
+
+    const auto out_size{static_cast<uInt>(
+        min<size_t>(size(buffer) - read_size, numeric_limits<uInt>::max()))};
+    m_stream.next_out = reinterpret_cast<Bytef*>(data(buffer) + read_size);
+    m_stream.avail_out = out_size;
+
+    const int code{inflate(&m_stream, Z_NO_FLUSH)};
+    read_size += out_size - m_stream.avail_out;
+
+    if (code == Z_STREAM_END) {
+      if (m_format == Format::kGzip &&
+          (m_stream.avail_in != 0 || !m_compressed.empty())) {
+        if (const int reset_code = inflateReset(&m_stream);
+            reset_code != Z_OK) {
+          ThrowError(reset_code);
+        }
+      } else {
+        m_finished = true;
+      }
+    } else if (code == Z_BUF_ERROR) {
+      throw runtime_error{"Unexpected end of compressed data"};
+    } else if (code != Z_OK) {
+      ThrowError(code);
+    }
+  }
+
+  return read_size;
+}
+
+//
+// zlib takes at most 4 GiB at once
+//
+void InflateStream::FeedInput() noexcept {
+  if (m_stream.avail_in == 0 && !m_compressed.empty()) {
+    const auto in_size{static_cast<uInt>(
+        min<size_t>(size(m_compressed), numeric_limits<uInt>::max()))};
+    m_stream.next_in = const_cast<Bytef*>(
+        reinterpret_cast<const Bytef*>(data(m_compressed)));
+    m_stream.avail_in = in_size;
+    m_compressed.remove_prefix(in_size);
+  }
+}
+
+//
+//
+//
+void InflateStream::ThrowError(int code) const {
+  throw runtime_error{fmt::format("Inflate error {}: {}", code,
+                                  m_stream.msg ? m_stream.msg : zError(code))};
+}
+
+#ifdef BACKBLAZE_WITH_ZSTD
+//
+// Concatenated frames are read as a single stream
+//
+class ZstdStream : public InputStream {
+ public:
+  explicit ZstdStream(string_view compressed)
+      : m_input{data(compressed), size(compressed), 0},
+        m_stream{ZSTD_createDStream()} {
+    if (!m_stream) {
+      throw bad_alloc{};
+    }
+  }
+
+  ZstdStream(const ZstdStream&) = delete;
+  ZstdStream& operator=(const ZstdStream&) = delete;
+
+  ~ZstdStream() override { ZSTD_freeDStream(m_stream); }
+
+  size_t Read(span<char> buffer) override {
+    ZSTD_outBuffer output{data(buffer), size(buffer), 0};
+    while (output.pos < output.size) {
+      if (m_input.pos == m_input.size && m_frame_complete) {
+        break;
+      }
+
+      const size_t prev_pos{output.pos};
+      const size_t code{ZSTD_decompressStream(m_stream, &output, &m_input)};
+      if (ZSTD_isError(code)) {
+        throw runtime_error{
+            fmt::format("Zstd error: {}", ZSTD_getErrorName(code))};
+      }
+
+      m_frame_complete = code == 0;  // Decoded and flushed
+      if (m_input.pos == m_input.size && output.pos == prev_pos &&
+          !m_frame_complete) {
+        throw runtime_error{"Unexpected end of compressed data"};
+      }
+    }
+
+    return output.pos;
+  }
+
+ private:
+  ZSTD_inBuffer m_input;
+  ZSTD_DStream* m_stream;
+  bool m_frame_complete{false};
+};
+#endif
+
+//
+//
+//
+Compression DetectCompression(string_view data) noexcept {
+  constexpr string_view kGzipMagic{"\x1F\x8B"};
+  constexpr string_view kZstdMagic{"\x28\xB5\x2F\xFD"};
+
+  if (data.starts_with(kGzipMagic)) {
+    return Compression::kGzip;
+  }
+
+  if (data.starts_with(kZstdMagic)) {
+    return Compression::kZstd;
+  }
+
+  return Compression::kNone;
+}
+
+//
+//
+//
+unique_ptr<InputStream> MakeDecompressor(string_view compressed,
+                                         Compression compression) {
+  switch (compression) {
+    case Compression::kGzip:
+      return make_unique<InflateStream>(compressed,
+                                        InflateStream::Format::kGzip);
+    case Compression::kZstd:
+#ifdef BACKBLAZE_WITH_ZSTD
+      return make_unique<ZstdStream>(compressed);
+#else
+      throw runtime_error{"Zstd support isn't compiled in"};
+#endif
+    default:
+      return make_unique<MemoryStream>(compressed);
+  }
+}
+}  // namespace util
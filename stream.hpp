@@ -0,0 +1,90 @@
+#pragma once
+#include <zlib.h>
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace util {
+//
+// Sequential source of bytes
+//
+class InputStream {
+ public:
+  virtual ~InputStream() = default;
+
+  //
+  // Reads up to size(buffer) bytes; 0 means the end of the stream
+  //
+  virtual size_t Read(std::span<char> buffer) = 0;
+};
+
+//
+// Stream over bytes which are already in memory
+//
+class MemoryStream : public InputStream {
+ public:
+  explicit MemoryStream(std::string_view data) noexcept : m_data{data} {}
+
+  size_t Read(std::span<char> buffer) override;
+
+ private:
+  std::string_view m_data;
+};
+
+//
+// Decompresses deflate data which is in memory, e.g. a mapped file
+//
+class InflateStream : public InputStream {
+ public:
+  enum class Format {
+    kRaw,   // Zip archive members
+    kGzip,  // Concatenated gzip members are read as a single stream
+  };
+
+ public:
+  InflateStream(std::string_view compressed, Format format);
+  InflateStream(const InflateStream&) = delete;
+  InflateStream& operator=(const InflateStream&) = delete;
+  ~InflateStream() override;
+
+  size_t Read(std::span<char> buffer) override;
+
+ private:
+  void FeedInput() noexcept;
+  [[noreturn]] void ThrowError(int code) const;
+
+ private:
+  std::string_view m_compressed;
+  Format m_format;
+  z_stream m_stream{};
+  bool m_finished{false};
+};
+
+//
+//
+//
+enum class Compression {
+  kNone,
+  kGzip,
+  kZstd,
+};
+
+//
+// Number of first bytes DetectCompression() needs at most
+//
+inline constexpr size_t kMaxMagicSize{4};
+
+//
+// Detects the compression by magic bytes
+//
+Compression DetectCompression(std::string_view data) noexcept;
+
+//
+// Decompresses data which is in memory by parts of the requested size;
+// zstd support depends on BACKBLAZE_WITH_ZSTD
+//
+std::unique_ptr<InputStream> MakeDecompressor(std::string_view compressed,
+                                              Compression compression);
+}  // namespace util
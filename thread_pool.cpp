@@ -0,0 +1,213 @@
+#include "thread_pool.hpp"
+#include "cpu.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace util {
+//
+// Worker of the pool the calling thread belongs to
+//
+static thread_local const ThreadPool* current_pool{nullptr};
+static thread_local size_t current_worker_idx{0};
+
+//
+// The creating thread isn't pinned, since threads it starts later, e.g.
+// of another pool, would inherit its single CPU
+//
+ThreadPool::ThreadPool(size_t thread_count, bool pin_threads)
+    : m_worker_count{max(thread_count, size_t{1}) - 1},
+      m_queues{make_unique<Queue[]>(m_worker_count + 1)} {
+  if (pin_threads) {
+    const auto cpus{GetAffinityCpus()};
+    for (size_t idx = 0; idx < m_worker_count && !cpus.empty(); ++idx) {
+      m_cpus.push_back(cpus[idx % size(cpus)]);
+    }
+  }
+
+  m_workers.reserve(m_worker_count);
+  for (size_t idx = 0; idx < m_worker_count; ++idx) {
+    m_workers.emplace_back(&ThreadPool::RunWorker, this, idx);
+  }
+}
+
+//
+// Groups wait for their tasks, so there are none left
+//
+ThreadPool::~ThreadPool() {
+  {
+    const scoped_lock lock{m_mutex};
+    m_stopping = true;
+  }
+  m_condition.notify_all();
+
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+//
+//
+//
+size_t ThreadPool::GetThreadIdx() const noexcept {
+  return current_pool == this ? current_worker_idx : m_worker_count;
+}
+
+//
+//
+//
+void ThreadPool::Resume(coroutine_handle<> handle) {
+  Submit([handle] { handle.resume(); });
+}
+
+//
+//
+//
+void ThreadPool::Submit(Task task) {
+  auto& queue{m_queues[GetThreadIdx()]};
+  {
+    const scoped_lock lock{queue.mutex};
+    queue.tasks.push_back(std::move(task));
+    m_task_count.fetch_add(1, memory_order_release);
+  }
+
+  {
+    // Sleepers check the count under the mutex
+    const scoped_lock lock{m_mutex};
+  }
+  m_condition.notify_one();
+}
+
+//
+// Other deques are visited starting from the next one to spread steals. The
+// deque of threads which aren't workers is a FIFO for all threads, so its
+// tasks run in the order of submission
+//
+bool ThreadPool::RunPendingTask() {
+  const size_t queue_count{m_worker_count + 1};
+  const size_t thread_idx{GetThreadIdx()};
+
+  Task task;
+  for (size_t offset = 0; offset < queue_count && !task; ++offset) {
+    auto& queue{m_queues[(thread_idx + offset) % queue_count]};
+
+    const scoped_lock lock{queue.mutex};
+    if (queue.tasks.empty()) {
+      continue;
+    }
+
+    if (offset == 0 && thread_idx < m_worker_count) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    m_task_count.fetch_sub(1, memory_order_relaxed);
+  }
+
+  if (!task) {
+    return false;
+  }
+
+  task();
+  return true;
+}
+
+//
+//
+//
+void ThreadPool::WaitForTask(const function<bool()>& is_done) {
+  unique_lock lock{m_mutex};
+  m_condition.wait(lock, [this, &is_done] {
+    return m_task_count.load(memory_order_acquire) != 0 || is_done();
+  });
+}
+
+//
+//
+//
+void ThreadPool::NotifyAll() {
+  {
+    const scoped_lock lock{m_mutex};
+  }
+  m_condition.notify_all();
+}
+
+//
+//
+//
+void ThreadPool::RunWorker(size_t worker_idx) {
+  current_pool = this;
+  current_worker_idx = worker_idx;
+
+  if (!m_cpus.empty()) {
+    PinThread(m_cpus[worker_idx]);
+  }
+
+  for (;;) {
+    if (RunPendingTask()) {
+      continue;
+    }
+
+    unique_lock lock{m_mutex};
+    m_condition.wait(lock, [this] {
+      return m_task_count.load(memory_order_acquire) != 0 || m_stopping;
+    });
+
+    if (m_stopping && m_task_count.load(memory_order_acquire) == 0) {
+      break;
+    }
+  }
+}
+
+//
+// Tasks refer to the group, so it can't go away before them
+//
+TaskGroup::~TaskGroup() {
+  try {
+    Wait();
+  } catch (...) {
+  }
+}
+
+//
+//
+//
+void TaskGroup::Wait() {
+  const auto is_done{
+      [this] { return m_pending.load(memory_order_acquire) == 0; }};
+
+  while (!is_done()) {
+    if (!m_pool.RunPendingTask()) {
+      m_pool.WaitForTask(is_done);
+    }
+  }
+
+  if (m_exc_ptr) {
+    rethrow_exception(exchange(m_exc_ptr, nullptr));
+  }
+}
+
+//
+//
+//
+void TaskGroup::SetException(exception_ptr exc_ptr) noexcept {
+  const scoped_lock lock{m_mutex};
+  if (!m_exc_ptr) {
+    m_exc_ptr = std::move(exc_ptr);
+  }
+}
+
+//
+// The group may be destroyed as soon as the count drops to 0, so only the
+// pool is used after that
+//
+void TaskGroup::Finish() noexcept {
+  auto& pool{m_pool};
+  if (m_pending.fetch_sub(1, memory_order_acq_rel) == 1) {
+    pool.NotifyAll();
+  }
+}
+}  // namespace util
@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace util {
+//
+// Worker threads with a deque of tasks each. A worker takes its own tasks
+// from the back, i.e. the latest ones whose data is likely in its cache, and
+// steals the oldest ones from the front of other deques when it runs out.
+// Threads which aren't workers submit tasks to a shared deque, which is
+// taken from the front by all threads, and run tasks while waiting for
+// them, so waits don't block any thread
+//
+class ThreadPool {
+ public:
+  //
+  // 'thread_count' threads run tasks: thread_count - 1 workers and a thread
+  // which waits for tasks. Pinned workers are bound to CPUs of the creating
+  // thread's affinity mask in turn, so memory they touch first, e.g. pages
+  // of their arenas, stays on their NUMA nodes. The creating thread keeps
+  // its mask
+  //
+  explicit ThreadPool(size_t thread_count, bool pin_threads = false);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  size_t GetThreadCount() const noexcept { return m_worker_count + 1; }
+
+  //
+  // Index of the calling worker in [0, GetThreadCount() - 1), or the last
+  // index for other threads. Data indexed by it is used by one thread at a
+  // time if a single other thread runs tasks
+  //
+  size_t GetThreadIdx() const noexcept;
+
+  //
+  // Resumes the suspended coroutine by a task of the pool
+  //
+  void Resume(std::coroutine_handle<> handle);
+
+ private:
+  friend class TaskGroup;
+
+  using Task = std::function<void()>;
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+ private:
+  //
+  // Task must not throw
+  //
+  void Submit(Task task);
+
+  //
+  // Runs a task of the calling thread or steals one; false if there are none
+  //
+  bool RunPendingTask();
+
+  //
+  // Sleeps until a task is submitted or the predicate is true
+  //
+  void WaitForTask(const std::function<bool()>& is_done);
+
+  void NotifyAll();
+
+  void RunWorker(size_t worker_idx);
+
+ private:
+  size_t m_worker_count;
+  std::vector<size_t> m_cpus;  // By workers if they are pinned
+  std::unique_ptr<Queue[]> m_queues;  // Workers' and the shared one
+  std::atomic<size_t> m_task_count{0};
+
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stopping{false};
+
+  std::vector<std::thread> m_workers;
+};
+
+//
+// Tasks which are waited for together. The first exception thrown by them
+// is rethrown by Wait() after all of them have finished
+//
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool& pool) noexcept : m_pool{pool} {}
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+  ~TaskGroup();
+
+  template <std::invocable Fn>
+  void Run(Fn fn) {
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    m_pool.Submit([this, fn = std::move(fn)]() mutable noexcept {
+      try {
+        fn();
+      } catch (...) {
+        SetException(std::current_exception());
+      }
+      Finish();
+    });
+  }
+
+  //
+  // Runs tasks of the pool until all tasks of the group have finished
+  //
+  void Wait();
+
+ private:
+  friend class Job;
+
+  void SetException(std::exception_ptr exc_ptr) noexcept;
+  void Finish() noexcept;
+
+ private:
+  ThreadPool& m_pool;
+  std::atomic<size_t> m_pending{0};
+
+  std::mutex m_mutex;
+  std::exception_ptr m_exc_ptr;
+};
+
+//
+// Runs fn(idx) for each idx in [0, count) as tasks of the pool and rethrows
+// the first exception after all of them have finished
+//
+template <std::invocable<size_t> Fn>
+void RunParallel(ThreadPool& pool, size_t count, Fn fn) {
+  TaskGroup group{pool};
+  for (size_t idx = 0; idx < count; ++idx) {
+    group.Run([&fn, idx] { fn(idx); });
+  }
+  group.Wait();
+}
+}  // namespace util
@@ -0,0 +1,218 @@
+#include "zip.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <concepts>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+using namespace std;
+
+namespace util {
+//
+//
+//
+static constexpr uint32_t kLocalHeaderSignature{0x04034b50};
+static constexpr uint32_t kCentralHeaderSignature{0x02014b50};
+static constexpr uint32_t kEndOfCentralDirSignature{0x06054b50};
+static constexpr uint32_t kZip64EndOfCentralDirSignature{0x06064b50};
+static constexpr uint32_t kZip64LocatorSignature{0x07064b50};
+
+static constexpr size_t kLocalHeaderSize{30};
+static constexpr size_t kCentralHeaderSize{46};
+static constexpr size_t kEndOfCentralDirSize{22};
+static constexpr size_t kZip64LocatorSize{20};
+static constexpr size_t kMaxCommentSize{numeric_limits<uint16_t>::max()};
+
+static constexpr uint16_t kZip64ExtraId{0x0001};
+static constexpr uint16_t kEncryptedFlag{0x0001};
+
+static constexpr uint16_t kStoredMethod{0};
+static constexpr uint16_t kDeflatedMethod{8};
+
+//
+//
+//
+static string_view Slice(string_view data, uint64_t offset, uint64_t length) {
+  if (offset > size(data) || length > size(data) - offset) {
+    throw runtime_error{"Zip archive is truncated"};
+  }
+  return data.substr(static_cast<size_t>(offset),
+                     static_cast<size_t>(length));
+}
+
+//
+//
+//
+template <unsigned_integral Ty>
+static Ty ReadLe(string_view data, uint64_t offset) {
+  const auto bytes{Slice(data, offset, sizeof(Ty))};
+
+  Ty value{0};
+  for (size_t idx = 0; idx < sizeof(Ty); ++idx) {
+    value |= static_cast<Ty>(static_cast<unsigned char>(bytes[idx]))
+             << (idx * 8);
+  }
+  return value;
+}
+
+//
+//
+//
+template <unsigned_integral Ty>
+static bool IsMaxValue(Ty value) noexcept {
+  return value == numeric_limits<Ty>::max();
+}
+
+//
+//
+//
+ZipArchive::ZipArchive(const filesystem::path& file_path)
+    : m_path{file_path}, m_file{file_path} {
+  ReadCentralDirectory();
+}
+
+//
+//
+//
+string_view ZipArchive::GetEntryData(size_t entry_idx) const {
+  const auto& entry{m_entries.at(entry_idx)};
+  if ((entry.flags & kEncryptedFlag) != 0) {
+    throw runtime_error{
+        fmt::format("{}: encrypted members aren't supported", entry.name)};
+  }
+
+  const string_view data{m_file.GetView()};
+  const auto header_offset{entry.local_header_offset};
+  if (ReadLe<uint32_t>(data, header_offset) != kLocalHeaderSignature) {
+    throw runtime_error{
+        fmt::format("{}: invalid local header signature", entry.name)};
+  }
+
+  const auto name_size{ReadLe<uint16_t>(data, header_offset + 26)};
+  const auto extra_size{ReadLe<uint16_t>(data, header_offset + 28)};
+  return Slice(data, header_offset + kLocalHeaderSize + name_size + extra_size,
+               entry.compressed_size);
+}
+
+//
+//
+//
+unique_ptr<InputStream> ZipArchive::OpenEntry(size_t entry_idx) const {
+  const auto& entry{m_entries.at(entry_idx)};
+  const auto compressed{GetEntryData(entry_idx)};
+
+  switch (entry.method) {
+    case kStoredMethod:
+      return make_unique<MemoryStream>(compressed);
+    case kDeflatedMethod:
+      return make_unique<InflateStream>(compressed,
+                                        InflateStream::Format::kRaw);
+    default:
+      throw runtime_error{
+          fmt::format("{}: compression method {} isn't supported", entry.name,
+                      entry.method)};
+  }
+}
+
+//
+// Sizes and offsets which don't fit into 32 bits are stored in the Zip64
+// extra field in a fixed order
+//
+static void ReadZip64Extra(ZipArchive::Entry& entry, string_view extra) {
+  while (size(extra) >= 4) {
+    const auto id{ReadLe<uint16_t>(extra, 0)};
+    const auto data{Slice(extra, 4, ReadLe<uint16_t>(extra, 2))};
+    extra.remove_prefix(4 + size(data));
+
+    if (id != kZip64ExtraId) {
+      continue;
+    }
+
+    size_t offset{0};
+    for (auto* value : {&entry.uncompressed_size, &entry.compressed_size,
+                        &entry.local_header_offset}) {
+      if (IsMaxValue(static_cast<uint32_t>(*value))) {
+        *value = ReadLe<uint64_t>(data, offset);
+        offset += sizeof(uint64_t);
+      }
+    }
+    break;
+  }
+}
+
+//
+//
+//
+void ZipArchive::ReadCentralDirectory() {
+  const string_view data{m_file.GetView()};
+  if (size(data) < kEndOfCentralDirSize) {
+    throw runtime_error{"Zip archive is truncated"};
+  }
+
+  // The record is followed by a comment of variable size
+  const size_t search_first{
+      size(data) - min(size(data), kEndOfCentralDirSize + kMaxCommentSize)};
+  size_t eocd_offset{size(data) - kEndOfCentralDirSize + 1};
+  do {
+    if (eocd_offset-- == search_first) {
+      throw runtime_error{"End of central directory record not found"};
+    }
+  } while (ReadLe<uint32_t>(data, eocd_offset) != kEndOfCentralDirSignature);
+
+  uint64_t entry_count{ReadLe<uint16_t>(data, eocd_offset + 10)};
+  uint64_t dir_size{ReadLe<uint32_t>(data, eocd_offset + 12)};
+  uint64_t dir_offset{ReadLe<uint32_t>(data, eocd_offset + 16)};
+
+  if (IsMaxValue(static_cast<uint16_t>(entry_count)) ||
+      IsMaxValue(static_cast<uint32_t>(dir_size)) ||
+      IsMaxValue(static_cast<uint32_t>(dir_offset))) {
+    if (eocd_offset < kZip64LocatorSize ||
+        ReadLe<uint32_t>(data, eocd_offset - kZip64LocatorSize) !=
+            kZip64LocatorSignature) {
+      throw runtime_error{"Zip64 end of central directory locator not found"};
+    }
+
+    const auto zip64_eocd_offset{
+        ReadLe<uint64_t>(data, eocd_offset - kZip64LocatorSize + 8)};
+    if (ReadLe<uint32_t>(data, zip64_eocd_offset) !=
+        kZip64EndOfCentralDirSignature) {
+      throw runtime_error{"Invalid Zip64 end of central directory record"};
+    }
+
+    entry_count = ReadLe<uint64_t>(data, zip64_eocd_offset + 32);
+    dir_size = ReadLe<uint64_t>(data, zip64_eocd_offset + 40);
+    dir_offset = ReadLe<uint64_t>(data, zip64_eocd_offset + 48);
+  }
+
+  auto dir{Slice(data, dir_offset, dir_size)};
+  m_entries.reserve(static_cast<size_t>(
+      min<uint64_t>(entry_count, size(dir) / kCentralHeaderSize)));
+
+  for (uint64_t idx = 0; idx < entry_count; ++idx) {
+    if (ReadLe<uint32_t>(dir, 0) != kCentralHeaderSignature) {
+      throw runtime_error{"Invalid central directory header signature"};
+    }
+
+    const auto name_size{ReadLe<uint16_t>(dir, 28)};
+    const auto extra_size{ReadLe<uint16_t>(dir, 30)};
+    const auto comment_size{ReadLe<uint16_t>(dir, 32)};
+
+    auto& entry{m_entries.emplace_back()};
+    entry.name = Slice(dir, kCentralHeaderSize, name_size);
+    entry.flags = ReadLe<uint16_t>(dir, 8);
+    entry.method = ReadLe<uint16_t>(dir, 10);
+    entry.compressed_size = ReadLe<uint32_t>(dir, 20);
+    entry.uncompressed_size = ReadLe<uint32_t>(dir, 24);
+    entry.local_header_offset = ReadLe<uint32_t>(dir, 42);
+
+    ReadZip64Extra(entry,
+                   Slice(dir, kCentralHeaderSize + name_size, extra_size));
+
+    dir.remove_prefix(min(
+        size(dir), kCentralHeaderSize + name_size + extra_size + comment_size));
+  }
+}
+}  // namespace util
@@ -0,0 +1,54 @@
+#pragma once
+#include "mapped_file.hpp"
+#include "stream.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+//
+// Members of a zip archive (Zip64 included) mapped into memory.
+// Only stored and deflated members are supported
+//
+class ZipArchive {
+ public:
+  struct Entry {
+    std::string name;
+    uint16_t flags;
+    uint16_t method;
+    uint64_t compressed_size;
+    uint64_t uncompressed_size;
+    uint64_t local_header_offset;
+  };
+
+ public:
+  explicit ZipArchive(const std::filesystem::path& file_path);
+
+  const std::filesystem::path& GetPath() const noexcept { return m_path; }
+
+  std::span<const Entry> GetEntries() const noexcept { return m_entries; }
+
+  //
+  // Compressed contents of the member in the mapped archive
+  //
+  std::string_view GetEntryData(size_t entry_idx) const;
+
+  //
+  // Decompressed contents of the member are read on the fly
+  //
+  std::unique_ptr<InputStream> OpenEntry(size_t entry_idx) const;
+
+ private:
+  void ReadCentralDirectory();
+
+ private:
+  std::filesystem::path m_path;
+  MappedFile m_file;
+  std::vector<Entry> m_entries;
+};
+}  // namespace util